@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "aarch64_decoder.h"
+
+// Number of entries of the per-thread decode cache, as a power of two
+#ifndef AARCH64_DECODE_CACHE_BITS
+#define AARCH64_DECODE_CACHE_BITS 10
+#endif
+
+namespace aarch64 {
+
+// Whether an instruction is handled by one of the lifters
+enum class Verdict : uint8_t { Empty, Unsupported, Supported };
+
+/**
+ * Decoded instruction, keyed by its address and its instruction word so that patched bytes never hit a stale entry
+ */
+struct DecodeCacheEntry {
+  uint64_t addr;
+  uint32_t word;
+  Verdict verdict;
+  // Decoded ahead of a miss and not looked up since
+  bool prefetched;
+  Instruction instr;
+};
+
+/**
+ * Direct-mapped decode cache, owned by a single thread
+ */
+class DecodeCache {
+public:
+  static constexpr size_t kEntries = static_cast<size_t>(1)
+                                     << AARCH64_DECODE_CACHE_BITS;
+
+private:
+  DecodeCacheEntry mEntries[kEntries] {};
+
+public:
+  DecodeCache() = default;
+  DecodeCache(const DecodeCache&) = delete;
+  DecodeCache& operator=(const DecodeCache&) = delete;
+
+  /**
+   * Look up a decoded instruction
+   *
+   * @return cached entry, or nullptr on a miss
+   */
+  DecodeCacheEntry* Lookup(uint64_t addr, uint32_t word) {
+    DecodeCacheEntry& entry = mEntries[(addr >> 2) & (kEntries - 1)];
+    if (entry.verdict != Verdict::Empty && entry.addr == addr &&
+        entry.word == word) {
+      return &entry;
+    }
+
+    return nullptr;
+  }
+
+  /**
+   * Claim the entry for an instruction, evicting whatever the slot held. The caller fills the verdict and the
+   * decoded instruction
+   */
+  DecodeCacheEntry& Insert(uint64_t addr, uint32_t word) {
+    DecodeCacheEntry& entry = mEntries[(addr >> 2) & (kEntries - 1)];
+    entry.addr = addr;
+    entry.word = word;
+    entry.verdict = Verdict::Empty;
+    entry.prefetched = false;
+    return entry;
+  }
+};
+
+} // namespace aarch64
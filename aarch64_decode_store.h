@@ -0,0 +1,365 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "aarch64_decoder.h"
+
+// Decoded instructions persisted in the metadata of a database, so that reopening it does not decode every
+// instruction again. Like the decode cache, records are keyed by address and instruction word: a record is only ever
+// used for the very word it was decoded from, so patched bytes, or the records of another binary, simply miss
+
+namespace aarch64 {
+
+/**
+ * Decoded instructions of a binary, an open addressing hash table keyed by address. Immutable once built, and then
+ * shared read-only by all threads
+ */
+class DecodeStore {
+public:
+  // Bumped whenever the serialized form changes, or the decoded form of an existing encoding class does
+  static constexpr uint32_t kFormatVersion = 3;
+
+  /**
+   * Decoded instruction, word 0 (UDF) marks an empty slot since it is never decoded
+   */
+  struct Record {
+    uint64_t addr;
+    uint32_t word;
+    Instruction instr;
+  };
+
+private:
+  static constexpr uint32_t kMagic = 0x44343641; // "A64D"
+
+  std::vector<Record> mRecords;
+  size_t mCount = 0;
+  // Digest of the functions the records were decoded from, for the database to tell whether the store is current
+  uint64_t mCoverage = 0;
+
+  // Changes whenever an opcode or an encoding class is added, which renumbers the stored opcodes
+  static uint32_t GetDecoderFingerprint() {
+    return static_cast<uint32_t>(Opcode::Count) << 16 |
+           static_cast<uint32_t>(kEncodingClassCount);
+  }
+
+  static size_t Hash(uint64_t addr) {
+    return static_cast<size_t>((addr >> 2) * 0x9E3779B97F4A7C15ull >> 32);
+  }
+
+  /**
+   * Reject the records of a corrupt database, which would index the register tables out of bounds
+   */
+  static bool IsValid(const Instruction& instr) {
+    return instr.opcode != Opcode::Invalid && instr.opcode < Opcode::Count &&
+           instr.rd < 32 && instr.rn < 32 && instr.rm < 32 && instr.ra < 32 &&
+           static_cast<uint8_t>(instr.cond) < 16 && instr.immr < 64 &&
+           instr.imms < 64 && instr.lsb < 64 && instr.width <= 64 &&
+           instr.count <= 4 && instr.lane < 16 && instr.size != 0 &&
+           instr.size <= 16 && (instr.size & (instr.size - 1)) == 0 &&
+           instr.esize <= 8 && (instr.esize & (instr.esize - 1)) == 0 &&
+           instr.pattern < 32;
+  }
+
+  static void Put(std::vector<uint8_t>& bytes, uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+      bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+    }
+  }
+
+  static uint64_t Get(const uint8_t*& data, size_t size) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++) {
+      value |= static_cast<uint64_t>(*data++) << (i * 8);
+    }
+    return value;
+  }
+
+  // Bytes per serialized record: address, word and the instruction fields one by one
+  static constexpr size_t kRecordSize = 8 + 4 + 19 + 8;
+
+  static void PutRecord(std::vector<uint8_t>& bytes, const Record& record) {
+    const Instruction& instr = record.instr;
+    Put(bytes, record.addr, 8);
+    Put(bytes, record.word, 4);
+    Put(bytes, static_cast<uint8_t>(instr.opcode), 1);
+    Put(bytes, instr.size, 1);
+    Put(bytes, instr.rd, 1);
+    Put(bytes, instr.rn, 1);
+    Put(bytes, instr.rm, 1);
+    Put(bytes, instr.ra, 1);
+    Put(bytes, static_cast<uint8_t>(instr.cond), 1);
+    Put(bytes, instr.immr, 1);
+    Put(bytes, instr.imms, 1);
+    Put(bytes, instr.lsb, 1);
+    Put(bytes, instr.width, 1);
+    Put(bytes, instr.hasImmediate, 1);
+    Put(bytes, instr.esize, 1);
+    Put(bytes, instr.count, 1);
+    Put(bytes, instr.hasLane, 1);
+    Put(bytes, instr.lane, 1);
+    Put(bytes, instr.writeback, 1);
+    Put(bytes, instr.order, 1);
+    Put(bytes, instr.pattern, 1);
+    Put(bytes, instr.imm, 8);
+  }
+
+  static Record GetRecord(const uint8_t* data) {
+    Record record;
+    Instruction& instr = record.instr;
+    record.addr = Get(data, 8);
+    record.word = static_cast<uint32_t>(Get(data, 4));
+    instr = Instruction();
+    instr.opcode = static_cast<Opcode>(Get(data, 1));
+    instr.size = static_cast<uint8_t>(Get(data, 1));
+    instr.rd = static_cast<uint8_t>(Get(data, 1));
+    instr.rn = static_cast<uint8_t>(Get(data, 1));
+    instr.rm = static_cast<uint8_t>(Get(data, 1));
+    instr.ra = static_cast<uint8_t>(Get(data, 1));
+    instr.cond = static_cast<Condition>(Get(data, 1));
+    instr.immr = static_cast<uint8_t>(Get(data, 1));
+    instr.imms = static_cast<uint8_t>(Get(data, 1));
+    instr.lsb = static_cast<uint8_t>(Get(data, 1));
+    instr.width = static_cast<uint8_t>(Get(data, 1));
+    instr.hasImmediate = Get(data, 1) != 0;
+    instr.esize = static_cast<uint8_t>(Get(data, 1));
+    instr.count = static_cast<uint8_t>(Get(data, 1));
+    instr.hasLane = Get(data, 1) != 0;
+    instr.lane = static_cast<uint8_t>(Get(data, 1));
+    instr.writeback = Get(data, 1) != 0;
+    instr.order = static_cast<uint8_t>(Get(data, 1));
+    instr.pattern = static_cast<uint8_t>(Get(data, 1));
+    instr.imm = Get(data, 8);
+    return record;
+  }
+
+public:
+  /**
+   * Allocate the table for up to count records, must be called once before Add
+   */
+  void Reserve(size_t count) {
+    size_t capacity = 16;
+    while (capacity < count * 2) {
+      capacity *= 2;
+    }
+
+    mRecords.assign(capacity, Record());
+    mCount = 0;
+  }
+
+  /**
+   * Add a decoded instruction, replacing any record of the same address
+   *
+   * @return false if the table is full
+   */
+  bool Add(uint64_t addr, uint32_t word, const Instruction& instr) {
+    if (word == 0 || mCount * 2 >= mRecords.size()) {
+      return false;
+    }
+
+    size_t mask = mRecords.size() - 1;
+    for (size_t slot = Hash(addr) & mask;; slot = (slot + 1) & mask) {
+      Record& record = mRecords[slot];
+      if (record.word == 0 || record.addr == addr) {
+        mCount += record.word == 0;
+        record = {addr, word, instr};
+        return true;
+      }
+    }
+  }
+
+  /**
+   * Look up the decoded form of the instruction word at addr
+   *
+   * @return stored instruction, or nullptr if the address is not stored or holds another word
+   */
+  const Instruction* Find(uint64_t addr, uint32_t word) const {
+    if (mRecords.empty()) {
+      return nullptr;
+    }
+
+    size_t mask = mRecords.size() - 1;
+    for (size_t slot = Hash(addr) & mask;; slot = (slot + 1) & mask) {
+      const Record& record = mRecords[slot];
+      if (record.word == 0) {
+        return nullptr;
+      } else if (record.addr == addr) {
+        return record.word == word ? &record.instr : nullptr;
+      }
+    }
+  }
+
+  size_t GetCount() const {
+    return mCount;
+  }
+
+  uint64_t GetCoverage() const {
+    return mCoverage;
+  }
+
+  void SetCoverage(uint64_t coverage) {
+    mCoverage = coverage;
+  }
+
+  /**
+   * Build the union of several stores, for a single lookup whatever the view. Since a record only ever matches the
+   * word it was decoded from, the record of any store may serve any view
+   */
+  static std::shared_ptr<const DecodeStore>
+  Merge(const std::vector<std::shared_ptr<const DecodeStore>>& stores) {
+    if (stores.size() == 1) {
+      return stores[0];
+    }
+
+    size_t count = 0;
+    for (const std::shared_ptr<const DecodeStore>& store : stores) {
+      count += store->mCount;
+    }
+
+    std::shared_ptr<DecodeStore> merged = std::make_shared<DecodeStore>();
+    merged->Reserve(count);
+    for (const std::shared_ptr<const DecodeStore>& store : stores) {
+      for (const Record& record : store->mRecords) {
+        if (record.word != 0) {
+          merged->Add(record.addr, record.word, record.instr);
+        }
+      }
+    }
+    return merged;
+  }
+
+  std::vector<uint8_t> Serialize() const {
+    std::vector<uint8_t> bytes;
+    bytes.reserve(28 + mCount * kRecordSize);
+    Put(bytes, kMagic, 4);
+    Put(bytes, kFormatVersion, 4);
+    Put(bytes, GetDecoderFingerprint(), 4);
+    Put(bytes, mCoverage, 8);
+    Put(bytes, mCount, 8);
+    for (const Record& record : mRecords) {
+      if (record.word != 0) {
+        PutRecord(bytes, record);
+      }
+    }
+
+    return bytes;
+  }
+
+  /**
+   * Rebuild the table from its serialized form
+   *
+   * @return false if the bytes were written by another format or decoder version, or are corrupt
+   */
+  bool Deserialize(const std::vector<uint8_t>& bytes) {
+    if (bytes.size() < 28) {
+      return false;
+    }
+
+    const uint8_t* data = bytes.data();
+    if (Get(data, 4) != kMagic || Get(data, 4) != kFormatVersion ||
+        Get(data, 4) != GetDecoderFingerprint()) {
+      return false;
+    }
+
+    uint64_t coverage = Get(data, 8);
+    uint64_t count = Get(data, 8);
+    if (count > (bytes.size() - 28) / kRecordSize) {
+      return false;
+    }
+
+    Reserve(static_cast<size_t>(count));
+    mCoverage = coverage;
+    for (uint64_t i = 0; i < count; i++, data += kRecordSize) {
+      Record record = GetRecord(data);
+      if (!IsValid(record.instr) ||
+          !Add(record.addr, record.word, record.instr)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+};
+
+/**
+ * Decode stores of the databases opened in this process, at most one per view, and their union. Threads keep their
+ * own reference to the union and only refresh it when the generation changes, so that decoding never takes the lock
+ */
+class DecodeStoreRegistry {
+private:
+  std::mutex mMutex;
+  std::vector<std::pair<const void*, std::shared_ptr<const DecodeStore>>>
+      mStores;
+  std::shared_ptr<const DecodeStore> mMerged;
+  std::atomic<uint64_t> mGeneration {0};
+
+public:
+  // Intentionally leaked, like the statistics registry
+  static DecodeStoreRegistry& Get() {
+    static DecodeStoreRegistry* registry = new DecodeStoreRegistry();
+    return *registry;
+  }
+
+  /**
+   * Set the store of a view, replacing its previous one, or remove it if store is nullptr, e.g. when the view is
+   * closed
+   */
+  void Set(const void* view, std::shared_ptr<const DecodeStore> store) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    bool found = false;
+    for (auto it = mStores.begin(); it != mStores.end(); ++it) {
+      if (it->first == view) {
+        mStores.erase(it);
+        found = true;
+        break;
+      }
+    }
+
+    if (!found && !store) {
+      return;
+    }
+
+    if (store) {
+      mStores.emplace_back(view, std::move(store));
+    }
+
+    std::vector<std::shared_ptr<const DecodeStore>> stores;
+    for (const auto& entry : mStores) {
+      stores.push_back(entry.second);
+    }
+    mMerged = stores.empty() ? nullptr : DecodeStore::Merge(stores);
+    mGeneration.fetch_add(1, std::memory_order_release);
+  }
+
+  /**
+   * Store of a view, or nullptr if it has none
+   */
+  std::shared_ptr<const DecodeStore> Find(const void* view) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& entry : mStores) {
+      if (entry.first == view) {
+        return entry.second;
+      }
+    }
+    return nullptr;
+  }
+
+  uint64_t GetGeneration() const {
+    return mGeneration.load(std::memory_order_acquire);
+  }
+
+  /**
+   * Union of the stores of all views, or nullptr if there is none
+   */
+  std::shared_ptr<const DecodeStore> GetMerged() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mMerged;
+  }
+};
+
+} // namespace aarch64
@@ -0,0 +1,1337 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Native decoder for the encoding classes handled by the lifters. Decoding is a pure function of the instruction word:
+// there is no state, no allocation and nothing to initialize, so it may be called from any thread
+
+namespace aarch64 {
+
+// Condition codes, numbered as in the instruction encoding
+enum class Condition : uint8_t {
+  EQ,
+  NE,
+  HS,
+  LO,
+  MI,
+  PL,
+  VS,
+  VC,
+  HI,
+  LS,
+  GE,
+  LT,
+  GT,
+  LE,
+  AL,
+  NV
+};
+
+inline Condition InvertCondition(Condition condition) {
+  return static_cast<Condition>(static_cast<uint8_t>(condition) ^ 1);
+}
+
+// Instructions, and the aliases they are resolved to, known to the decoder
+enum class Opcode : uint8_t {
+  Invalid,
+  CSEL,
+  CSINC,
+  CINC,
+  CSET,
+  CSINV,
+  CINV,
+  CSETM,
+  CSNEG,
+  CNEG,
+  MADD,
+  MUL,
+  MSUB,
+  MNEG,
+  SMADDL,
+  SMULL,
+  SMSUBL,
+  SMNEGL,
+  UMADDL,
+  UMULL,
+  UMSUBL,
+  UMNEGL,
+  SMULH,
+  UMULH,
+  BFM,
+  BFI,
+  BFXIL,
+  UBFM,
+  LSL,
+  LSR,
+  UBFIZ,
+  UBFX,
+  UXTB,
+  UXTH,
+  SBFM,
+  ASR,
+  SBFIZ,
+  SBFX,
+  SXTB,
+  SXTH,
+  SXTW,
+  EXTR,
+  RORV,
+  ROR,
+  ADRP,
+  ADD,
+  SUB,
+  LDR,
+  MOVZ,
+  MOVN,
+  MOVK,
+  // Atomics and exclusive loads and stores, kept contiguous. The LSE atomics are in the order of their intrinsics
+  LDADD,
+  LDCLR,
+  LDEOR,
+  LDSET,
+  SWP,
+  CAS,
+  LDXR,
+  STXR,
+  // CRC32 and CRC32C of each data size, in the order of their intrinsics
+  CRC32B,
+  CRC32H,
+  CRC32W,
+  CRC32X,
+  CRC32CB,
+  CRC32CH,
+  CRC32CW,
+  CRC32CX,
+  BR,
+  // Comparisons and the instructions reading their flags, kept contiguous
+  SUBS,
+  CMP,
+  CCMP,
+  CCMN,
+  BCOND,
+  // Pointer authentication, kept contiguous. PACIA to XPACD in the order of their encoding and of their intrinsics,
+  // then the branches to an authenticated register
+  PACIA,
+  PACIB,
+  PACDA,
+  PACDB,
+  AUTIA,
+  AUTIB,
+  AUTDA,
+  AUTDB,
+  XPACI,
+  XPACD,
+  RETAA,
+  RETAB,
+  BRAA,
+  BRAB,
+  BLRAA,
+  BLRAB,
+  // Vector instructions, kept contiguous. Mnemonics shared with a scalar instruction are prefixed with V
+  VADD,
+  VSUB,
+  VAND,
+  VBIC,
+  VORR,
+  VMOV,
+  VEOR,
+  DUP,
+  MOVI,
+  MVNI,
+  EXT,
+  TBL,
+  LD1,
+  ST1,
+  // Cryptographic extension, AES to SHA512SU0 in the order of their intrinsics
+  AESE,
+  AESD,
+  AESMC,
+  AESIMC,
+  SHA1C,
+  SHA1P,
+  SHA1M,
+  SHA1SU0,
+  SHA256H,
+  SHA256H2,
+  SHA256SU1,
+  SHA1H,
+  SHA1SU1,
+  SHA256SU0,
+  SHA512H,
+  SHA512H2,
+  SHA512SU1,
+  SHA512SU0,
+  PMULL,
+  PMULL2,
+  // Scalable vector extension, kept contiguous and grouped by element size in B, H, W and D order. Mnemonics shared
+  // with another instruction are prefixed with Z, and the predicated forms suffixed with M for merging
+  PTRUE,
+  WHILELT,
+  WHILELE,
+  WHILELO,
+  WHILELS,
+  CNTB,
+  CNTH,
+  CNTW,
+  CNTD,
+  INCB,
+  INCH,
+  INCW,
+  INCD,
+  DECB,
+  DECH,
+  DECW,
+  DECD,
+  LD1B,
+  LD1H,
+  LD1W,
+  LD1D,
+  ST1B,
+  ST1H,
+  ST1W,
+  ST1D,
+  ZADD,
+  ZSUB,
+  ZADDM,
+  ZSUBM,
+  CMPEQ,
+  CMPNE,
+  CMPGE,
+  CMPGT,
+  CMPHS,
+  CMPHI,
+  CMPLT,
+  CMPLE,
+  Count
+};
+
+constexpr const char* kOpcodeNames[] = {
+    "invalid",   "csel",    "csinc",     "cinc",    "cset",     "csinv",
+    "cinv",      "csetm",   "csneg",     "cneg",    "madd",     "mul",
+    "msub",      "mneg",    "smaddl",    "smull",   "smsubl",   "smnegl",
+    "umaddl",    "umull",   "umsubl",    "umnegl",  "smulh",    "umulh",
+    "bfm",       "bfi",     "bfxil",     "ubfm",    "lsl",      "lsr",
+    "ubfiz",     "ubfx",    "uxtb",      "uxth",    "sbfm",     "asr",
+    "sbfiz",     "sbfx",    "sxtb",      "sxth",    "sxtw",     "extr",
+    "rorv",      "ror",     "adrp",      "add",     "sub",      "ldr",
+    "movz",      "movn",    "movk",      "ldadd",   "ldclr",    "ldeor",
+    "ldset",     "swp",     "cas",       "ldxr",    "stxr",     "crc32b",
+    "crc32h",    "crc32w",  "crc32x",    "crc32cb", "crc32ch",  "crc32cw",
+    "crc32cx",   "br",      "subs",      "cmp",     "ccmp",     "ccmn",
+    "b.cond",    "pacia",   "pacib",     "pacda",   "pacdb",    "autia",
+    "autib",     "autda",   "autdb",     "xpaci",   "xpacd",    "retaa",
+    "retab",     "braa",    "brab",      "blraa",   "blrab",    "vadd",
+    "vsub",      "vand",    "vbic",      "vorr",    "vmov",     "veor",
+    "dup",       "movi",    "mvni",      "ext",     "tbl",      "ld1",
+    "st1",       "aese",    "aesd",      "aesmc",   "aesimc",   "sha1c",
+    "sha1p",     "sha1m",   "sha1su0",   "sha256h", "sha256h2", "sha256su1",
+    "sha1h",     "sha1su1", "sha256su0", "sha512h", "sha512h2", "sha512su1",
+    "sha512su0", "pmull",   "pmull2",    "ptrue",   "whilelt",  "whilele",
+    "whilelo",   "whilels", "cntb",      "cnth",    "cntw",     "cntd",
+    "incb",      "inch",    "incw",      "incd",    "decb",     "dech",
+    "decw",      "decd",    "ld1b",      "ld1h",    "ld1w",     "ld1d",
+    "st1b",      "st1h",    "st1w",      "st1d",    "zadd",     "zsub",
+    "zaddm",     "zsubm",   "cmpeq",     "cmpne",   "cmpge",    "cmpgt",
+    "cmphs",     "cmphi",   "cmplt",     "cmple",
+};
+
+static_assert(sizeof(kOpcodeNames) / sizeof(kOpcodeNames[0]) ==
+                  static_cast<size_t>(Opcode::Count),
+              "kOpcodeNames must have a name for every opcode");
+
+inline const char* GetOpcodeName(Opcode opcode) {
+  return kOpcodeNames[static_cast<size_t>(opcode)];
+}
+
+/**
+ * Returns true for the conditional select family, aliases included
+ */
+inline bool IsConditionalSelectOpcode(Opcode opcode) {
+  return opcode >= Opcode::CSEL && opcode <= Opcode::CNEG;
+}
+
+/**
+ * Returns true for the vector instructions, whose register fields name SIMD&FP registers
+ */
+inline bool IsVectorOpcode(Opcode opcode) {
+  return opcode >= Opcode::VADD && opcode <= Opcode::PMULL2;
+}
+
+/**
+ * Returns true for the scalable vector instructions, whose register fields name Z and P registers, or the general
+ * purpose registers of the loop counters and addresses
+ */
+inline bool IsScalableOpcode(Opcode opcode) {
+  return opcode >= Opcode::PTRUE && opcode <= Opcode::CMPLE;
+}
+
+/**
+ * Returns true for the atomics and the exclusive loads and stores, whose operand size is the size of the memory access
+ */
+inline bool IsAtomicOpcode(Opcode opcode) {
+  return opcode >= Opcode::LDADD && opcode <= Opcode::STXR;
+}
+
+/**
+ * Returns true for the comparisons and B.cond, which are lifted with the flags and the flag write type of the base
+ * architecture
+ */
+inline bool IsComparisonOpcode(Opcode opcode) {
+  return opcode >= Opcode::SUBS && opcode <= Opcode::BCOND;
+}
+
+/**
+ * Returns true for the pointer authentication instructions, the authenticated branches included
+ */
+inline bool IsPointerAuthOpcode(Opcode opcode) {
+  return opcode >= Opcode::PACIA && opcode <= Opcode::BLRAB;
+}
+
+// Memory ordering of the atomics and the exclusive loads and stores, as a bit mask
+constexpr uint8_t kOrderAcquire = 1;
+constexpr uint8_t kOrderRelease = 2;
+
+// Shift types of the shifted register operands
+constexpr uint8_t kShiftLsl = 0;
+constexpr uint8_t kShiftLsr = 1;
+constexpr uint8_t kShiftAsr = 2;
+
+/**
+ * Compact form of a decoded instruction
+ *
+ * Register fields hold the register number from the encoding, whether 31 means the zero register or the stack
+ * pointer is up to the instruction
+ */
+struct Instruction {
+  Opcode opcode;
+  // Operand size in bytes, 4 or 8, the access size of the atomics, or 8 or 16 for the vector instructions. The
+  // scalable vector instructions have no fixed register size, this is that of their general purpose register operands
+  uint8_t size;
+  uint8_t rd;
+  uint8_t rn;
+  uint8_t rm;
+  // The accumulator, or the governing predicate of the scalable vector instructions
+  uint8_t ra;
+  Condition cond;
+  uint8_t immr;
+  uint8_t imms;
+  // Bit position and number of bits of the bitfield move aliases, resolved from immr and imms, and of the MOVK field
+  uint8_t lsb;
+  uint8_t width;
+  // The last source operand is imm rather than rm, the zero modifier of the pointer authentication instructions. The
+  // element counts also set it for their multiplier, and LD1B to ST1D for an offset in multiples of the vector length
+  bool hasImmediate;
+  uint64_t imm;
+  // Element size in bytes of the vector arrangement
+  uint8_t esize;
+  // Number of registers of a vector register list, starting at rn for TBL and at rd for LD1 and ST1
+  uint8_t count;
+  // DUP reads this lane of the Rn vector register, rather than the Rn general purpose register
+  bool hasLane;
+  uint8_t lane;
+  // LD1 and ST1 post-increment the base register, by imm or by rm
+  bool writeback;
+  // Memory ordering of the atomics, kOrderAcquire and kOrderRelease bits
+  uint8_t order;
+  // Predicate constraint of PTRUE and of the element counts, kPatternAll for every element
+  uint8_t pattern;
+};
+
+constexpr uint8_t kPatternAll = 31;
+
+/**
+ * Bit field in an instruction word
+ */
+struct Field {
+  uint8_t lsb;
+  uint8_t width;
+};
+
+constexpr uint32_t Extract(uint32_t word, Field field) {
+  return (word >> field.lsb) & ((1u << field.width) - 1);
+}
+
+constexpr Field kNone = {0, 0};
+constexpr Field kSf = {31, 1};
+constexpr Field kN = {22, 1};
+constexpr Field kImmLo = {29, 2};
+constexpr Field kImmHi = {5, 19};
+constexpr Field kImm12 = {10, 12};
+constexpr Field kImm12Shift = {22, 1};
+constexpr Field kAddSubImmediateForm = {28, 1};
+constexpr Field kConditionalCompareOp = {30, 1};
+constexpr Field kConditionalCompareImmediateForm = {11, 1};
+constexpr Field kImm19 = {5, 19};
+constexpr Field kLoadStoreSize = {30, 2};
+constexpr Field kImm16 = {5, 16};
+constexpr Field kHw = {21, 2};
+constexpr Field kQ = {30, 1};
+constexpr Field kOp = {29, 1};
+constexpr Field kVectorSize = {22, 2};
+constexpr Field kImm5 = {16, 5};
+constexpr Field kImm4 = {11, 4};
+constexpr Field kTableLength = {13, 2};
+constexpr Field kCmode = {12, 4};
+constexpr Field kAbc = {16, 3};
+constexpr Field kDefgh = {5, 5};
+constexpr Field kLoadStoreOpcode = {12, 4};
+constexpr Field kLoad = {22, 1};
+constexpr Field kPostIndex = {23, 1};
+constexpr Field kAtomicOpcode = {12, 2};
+constexpr Field kAtomicAcquire = {23, 1};
+constexpr Field kAtomicRelease = {22, 1};
+constexpr Field kCasAcquire = {22, 1};
+constexpr Field kExclusiveOrdered = {15, 1};
+constexpr Field kCrcSize = {10, 2};
+constexpr Field kCrcPolynomial = {12, 1};
+constexpr Field kCryptoOpcode = {12, 2};
+constexpr Field kShaOpcode = {12, 3};
+constexpr Field kSha512Opcode = {10, 2};
+constexpr Field kHintCrm = {8, 4};
+constexpr Field kHintOp2 = {5, 3};
+constexpr Field kPacOpcode = {10, 3};
+constexpr Field kPacZero = {13, 1};
+constexpr Field kXpacData = {10, 1};
+constexpr Field kBranchKey = {10, 1};
+constexpr Field kBranchModifier = {24, 1};
+constexpr Field kBranchLink = {21, 1};
+constexpr Field kPattern = {5, 5};
+constexpr Field kWhileSf = {12, 1};
+constexpr Field kWhileUnsigned = {11, 1};
+constexpr Field kWhileLessThan = {10, 1};
+constexpr Field kWhileEqual = {4, 1};
+constexpr Field kElementCountImm = {16, 4};
+constexpr Field kElementCountIncrement = {20, 1};
+constexpr Field kElementCountDecrement = {10, 1};
+constexpr Field kScalableDtype = {21, 4};
+constexpr Field kScalableImmediateForm = {13, 1};
+constexpr Field kScalableImm4 = {16, 4};
+constexpr Field kScalableSub = {10, 1};
+constexpr Field kScalablePredicatedSub = {16, 1};
+constexpr Field kCompareOp = {15, 1};
+constexpr Field kCompareO2 = {13, 1};
+constexpr Field kCompareNe = {4, 1};
+constexpr Field kCompareImm = {16, 5};
+
+/**
+ * Operand fields of an encoding layout, fields with a zero width are not present
+ */
+struct Layout {
+  Field rd;
+  Field rn;
+  Field rm;
+  Field ra;
+  Field cond;
+  Field immr;
+  Field imms;
+};
+
+enum LayoutIndex : uint8_t {
+  kConditionalSelect,
+  kDataProcessing3,
+  kDataProcessing2,
+  kBitfield,
+  kExtract,
+  kPcRelative,
+  kAddSubImmediate,
+  kAddSubRegister,
+  kConditionalCompare,
+  kConditionalBranch,
+  kLoadStoreImmediate,
+  kMoveWide,
+  kAtomic,
+  kPointerAuth,
+  kBranchRegister,
+  kVector,
+  kScalable,
+};
+
+constexpr Layout kLayouts[] = {
+    // kConditionalSelect
+    {{0, 5}, {5, 5}, {16, 5}, kNone, {12, 4}, kNone, kNone},
+    // kDataProcessing3
+    {{0, 5}, {5, 5}, {16, 5}, {10, 5}, kNone, kNone, kNone},
+    // kDataProcessing2
+    {{0, 5}, {5, 5}, {16, 5}, kNone, kNone, kNone, kNone},
+    // kBitfield
+    {{0, 5}, {5, 5}, kNone, kNone, kNone, {16, 6}, {10, 6}},
+    // kExtract
+    {{0, 5}, {5, 5}, {16, 5}, kNone, kNone, kNone, {10, 6}},
+    // kPcRelative
+    {{0, 5}, kNone, kNone, kNone, kNone, kNone, kNone},
+    // kAddSubImmediate
+    {{0, 5}, {5, 5}, kNone, kNone, kNone, kNone, kNone},
+    // kAddSubRegister: immr is the shift type of Rm and imms its amount
+    {{0, 5}, {5, 5}, {16, 5}, kNone, kNone, {22, 2}, {10, 6}},
+    // kConditionalCompare: rm is the immediate of the immediate forms, imms the NZCV value set when cond is false
+    {kNone, {5, 5}, {16, 5}, kNone, {12, 4}, kNone, {0, 4}},
+    // kConditionalBranch
+    {kNone, kNone, kNone, kNone, {0, 4}, kNone, kNone},
+    // kLoadStoreImmediate
+    {{0, 5}, {5, 5}, kNone, kNone, kNone, kNone, kNone},
+    // kMoveWide
+    {{0, 5}, kNone, kNone, kNone, kNone, kNone, kNone},
+    // kAtomic: rd is Rt, rm is Rs, the register operand of the LSE atomics, the compare value of CAS and the status
+    // register of STXR
+    {{0, 5}, {5, 5}, {16, 5}, kNone, kNone, kNone, kNone},
+    // kPointerAuth: rd is the pointer, rn the modifier
+    {{0, 5}, {5, 5}, kNone, kNone, kNone, kNone, kNone},
+    // kBranchRegister: rn is the target, rm the modifier
+    {kNone, {5, 5}, {0, 5}, kNone, kNone, kNone, kNone},
+    // kVector, the remaining fields differ between the classes and are decoded by ResolveVector
+    {{0, 5}, {5, 5}, {16, 5}, kNone, kNone, kNone, kNone},
+    // kScalable: ra is the governing predicate, the remaining fields are decoded by ResolveScalable
+    {{0, 5}, {5, 5}, {16, 5}, {10, 3}, kNone, kNone, kNone},
+};
+
+/**
+ * Raw encoding class of an instruction, a 32-bit instruction word belongs to the class if (word & mask) == value
+ */
+struct EncodingClass {
+  uint32_t mask;
+  uint32_t value;
+  Opcode opcode;
+  LayoutIndex layout;
+};
+
+// Encoding classes of the instructions handled by the lifters. Every lifter registers the classes of all the encodings
+// it may be called for, aliases included. An instruction word that matches none of them is not decoded at all
+constexpr EncodingClass kEncodingClasses[] = {
+    {0x7FE00C00, 0x1A800000, Opcode::CSEL, kConditionalSelect},
+    {0x7FE00C00, 0x1A800400, Opcode::CSINC, kConditionalSelect},
+    {0x7FE00C00, 0x5A800000, Opcode::CSINV, kConditionalSelect},
+    {0x7FE00C00, 0x5A800400, Opcode::CSNEG, kConditionalSelect},
+    {0x7FE08000, 0x1B000000, Opcode::MADD, kDataProcessing3},
+    {0x7FE08000, 0x1B008000, Opcode::MSUB, kDataProcessing3},
+    {0xFFE08000, 0x9B200000, Opcode::SMADDL, kDataProcessing3},
+    {0xFFE08000, 0x9B208000, Opcode::SMSUBL, kDataProcessing3},
+    {0xFFE08000, 0x9BA00000, Opcode::UMADDL, kDataProcessing3},
+    {0xFFE08000, 0x9BA08000, Opcode::UMSUBL, kDataProcessing3},
+    {0xFFE08000, 0x9B400000, Opcode::SMULH, kDataProcessing3},
+    {0xFFE08000, 0x9BC00000, Opcode::UMULH, kDataProcessing3},
+    {0x7F800000, 0x33000000, Opcode::BFM, kBitfield},
+    {0x7F800000, 0x53000000, Opcode::UBFM, kBitfield},
+    {0x7F800000, 0x13000000, Opcode::SBFM, kBitfield},
+    {0x7FA00000, 0x13800000, Opcode::EXTR, kExtract},
+    {0x7FE0FC00, 0x1AC02C00, Opcode::RORV, kDataProcessing2},
+    {0x9F000000, 0x90000000, Opcode::ADRP, kPcRelative},
+    // ADD (immediate), then ADD and SUB (shifted register)
+    {0x7F800000, 0x11000000, Opcode::ADD, kAddSubImmediate},
+    {0x7F200000, 0x0B000000, Opcode::ADD, kAddSubRegister},
+    {0x7F200000, 0x4B000000, Opcode::SUB, kAddSubRegister},
+    // SUBS (immediate), then SUBS (shifted register) with LSL, CMP when Rd is the zero register
+    {0x7F800000, 0x71000000, Opcode::SUBS, kAddSubImmediate},
+    {0x7FE00000, 0x6B000000, Opcode::SUBS, kAddSubRegister},
+    // CCMP and CCMN told apart by op, of registers and immediates
+    {0x3FE00410, 0x3A400000, Opcode::CCMN, kConditionalCompare},
+    {0xFF000010, 0x54000000, Opcode::BCOND, kConditionalBranch},
+    // LDR (immediate, unsigned offset) of W and X registers
+    {0xBFC00000, 0xB9400000, Opcode::LDR, kLoadStoreImmediate},
+    {0x7F800000, 0x52800000, Opcode::MOVZ, kMoveWide},
+    {0x7F800000, 0x12800000, Opcode::MOVN, kMoveWide},
+    {0x7F800000, 0x72800000, Opcode::MOVK, kMoveWide},
+    // LDADD, LDCLR, LDEOR and LDSET told apart by opc, with all their ordering and size variants and the ST* aliases
+    {0x3F20CC00, 0x38200000, Opcode::LDADD, kAtomic},
+    {0x3F20FC00, 0x38208000, Opcode::SWP, kAtomic},
+    {0x3FA07C00, 0x08A07C00, Opcode::CAS, kAtomic},
+    // LDXR and LDAXR, STXR and STLXR, of every size
+    {0x3FFF7C00, 0x085F7C00, Opcode::LDXR, kAtomic},
+    {0x3FE07C00, 0x08007C00, Opcode::STXR, kAtomic},
+    // CRC32 and CRC32C told apart by C, of every data size
+    {0x7FE0E000, 0x1AC04000, Opcode::CRC32B, kDataProcessing2},
+    // PACIA to AUTDB and their zero modifier forms, then their hint forms on X17 and on X30, told apart by opcode
+    {0xFFFFC000, 0xDAC10000, Opcode::PACIA, kPointerAuth},
+    {0xFFFFFF3F, 0xD503211F, Opcode::PACIA, kPointerAuth},
+    {0xFFFFFF1F, 0xD503231F, Opcode::PACIA, kPointerAuth},
+    // XPACI and XPACD, and XPACLRI
+    {0xFFFFFBE0, 0xDAC143E0, Opcode::XPACI, kPointerAuth},
+    {0xFFFFFFFF, 0xD50320FF, Opcode::XPACI, kPointerAuth},
+    // BR, the branches to a plain register are otherwise left to the base lifter
+    {0xFFFFFC1F, 0xD61F0000, Opcode::BR, kBranchRegister},
+    // RETAA and RETAB, then BRAA, BRAB, BLRAA and BLRAB and their zero modifier forms
+    {0xFFFFFBFF, 0xD65F0BFF, Opcode::RETAA, kBranchRegister},
+    {0xFEDFF800, 0xD61F0800, Opcode::BRAA, kBranchRegister},
+    {0xBF20FC00, 0x0E208400, Opcode::VADD, kVector},
+    {0xBF20FC00, 0x2E208400, Opcode::VSUB, kVector},
+    {0xBFE0FC00, 0x0E201C00, Opcode::VAND, kVector},
+    {0xBFE0FC00, 0x0E601C00, Opcode::VBIC, kVector},
+    {0xBFE0FC00, 0x0EA01C00, Opcode::VORR, kVector},
+    {0xBFE0FC00, 0x2E201C00, Opcode::VEOR, kVector},
+    // DUP (element) and DUP (general)
+    {0xBFE0FC00, 0x0E000400, Opcode::DUP, kVector},
+    {0xBFE0FC00, 0x0E000C00, Opcode::DUP, kVector},
+    // Modified immediate: MOVI, MVNI, ORR (immediate), BIC (immediate) and FMOV
+    {0x9FF80C00, 0x0F000400, Opcode::MOVI, kVector},
+    {0xBFE08400, 0x2E000000, Opcode::EXT, kVector},
+    {0xBFE09C00, 0x0E000000, Opcode::TBL, kVector},
+    // Load/store multiple structures without offset and post-indexed, ST1 included
+    {0xBFBF0000, 0x0C000000, Opcode::LD1, kVector},
+    {0xBFA00000, 0x0C800000, Opcode::LD1, kVector},
+    // AES, the three-register SHA, the two-register SHA and the SHA512 classes, each told apart by its opcode field
+    {0xFFFFCC00, 0x4E284800, Opcode::AESE, kVector},
+    {0xFF208C00, 0x5E000000, Opcode::SHA1C, kVector},
+    {0xFFFFCC00, 0x5E280800, Opcode::SHA1H, kVector},
+    {0xFFE0F000, 0xCE608000, Opcode::SHA512H, kVector},
+    {0xFFFFFC00, 0xCEC08000, Opcode::SHA512SU0, kVector},
+    // PMULL and PMULL2 of 8B and 1D elements
+    {0xBF20FC00, 0x0E20E000, Opcode::PMULL, kVector},
+    // SVE PTRUE, WHILELT to WHILELS, then CNTB to CNTD, INCB to INCD and DECB to DECD of an X register
+    {0xFF3FFC10, 0x2518E000, Opcode::PTRUE, kScalable},
+    {0xFF20E000, 0x25200000, Opcode::WHILELT, kScalable},
+    {0xFF20F800, 0x0420E000, Opcode::CNTB, kScalable},
+    // LD1B to LD1D and ST1B to ST1D, scalar plus scalar then scalar plus immediate, told apart by dtype
+    {0xFE00E000, 0xA4004000, Opcode::LD1B, kScalable},
+    {0xFE10E000, 0xA400A000, Opcode::LD1B, kScalable},
+    {0xFE00E000, 0xE4004000, Opcode::ST1B, kScalable},
+    {0xFE10E000, 0xE400E000, Opcode::ST1B, kScalable},
+    // ADD and SUB of vectors, unpredicated then predicated
+    {0xFF20F800, 0x04200000, Opcode::ZADD, kScalable},
+    {0xFF3EE000, 0x04000000, Opcode::ZADDM, kScalable},
+    // Integer compares of vectors, then with a signed immediate, told apart by op, o2 and ne
+    {0xFF204000, 0x24000000, Opcode::CMPHS, kScalable},
+    {0xFF204000, 0x25000000, Opcode::CMPLT, kScalable},
+};
+
+constexpr size_t kEncodingClassCount =
+    sizeof(kEncodingClasses) / sizeof(kEncodingClasses[0]);
+
+// Repeat the low bits of value over 64 bits
+inline uint64_t Replicate(uint64_t value, unsigned int bits) {
+  for (; bits < 64; bits *= 2) {
+    value |= value << bits;
+  }
+  return value;
+}
+
+/**
+ * Decode the modified immediate class: expands the 8-bit immediate into the 64-bit pattern of every lane, and
+ * resolves the instruction from op and cmode
+ *
+ * @return false for FMOV, which no lifter handles, and the unallocated encodings
+ */
+inline bool ResolveVectorImmediate(uint32_t word, Instruction& instr) {
+  uint32_t cmode = Extract(word, kCmode);
+  bool op = Extract(word, kOp);
+  uint64_t imm8 = Extract(word, kAbc) << 5 | Extract(word, kDefgh);
+
+  if (cmode < 12) {
+    // 32-bit lanes shifted by 0, 8, 16 or 24, or 16-bit lanes shifted by 0 or 8. Odd cmodes are ORR and BIC
+    instr.imm = cmode < 8 ? Replicate(imm8 << (cmode >> 1) * 8, 32)
+                          : Replicate(imm8 << (cmode >> 1 & 1) * 8, 16);
+    if (cmode & 1) {
+      instr.opcode = op ? Opcode::VBIC : Opcode::VORR;
+      instr.hasImmediate = true;
+    } else {
+      instr.opcode = op ? Opcode::MVNI : Opcode::MOVI;
+    }
+  } else if (cmode < 14) {
+    // 32-bit lanes, shifting ones in
+    instr.imm =
+        Replicate(cmode & 1 ? imm8 << 16 | 0xFFFF : imm8 << 8 | 0xFF, 32);
+    instr.opcode = op ? Opcode::MVNI : Opcode::MOVI;
+  } else if (cmode == 14 && !op) {
+    instr.imm = Replicate(imm8, 8);
+  } else if (cmode == 14) {
+    // Every bit of imm8 expanded to a byte
+    for (unsigned int bit = 0; bit < 8; bit++) {
+      if (imm8 >> bit & 1) {
+        instr.imm |= static_cast<uint64_t>(0xFF) << bit * 8;
+      }
+    }
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * Offset an opcode within a group of opcodes told apart by a field of the encoding
+ */
+inline Opcode OffsetOpcode(Opcode first, uint32_t index) {
+  return static_cast<Opcode>(static_cast<uint8_t>(first) + index);
+}
+
+/**
+ * Validate and resolve the fields of the vector instructions. The operand size is the register size given by Q
+ *
+ * @return false if the encoding is unallocated, or one of the encodings of the class no lifter handles
+ */
+inline bool ResolveVector(uint32_t word, Instruction& instr) {
+  bool q = Extract(word, kQ);
+  instr.size = q ? 16 : 8;
+
+  switch (instr.opcode) {
+  case Opcode::VADD:
+  case Opcode::VSUB:
+    // 1D only exists as a scalar instruction
+    if (Extract(word, kVectorSize) == 3 && !q) {
+      return false;
+    }
+    instr.esize = 1 << Extract(word, kVectorSize);
+    return true;
+  case Opcode::VORR:
+    if (instr.rn == instr.rm) {
+      instr.opcode = Opcode::VMOV;
+    }
+    return true;
+  case Opcode::DUP: {
+    uint32_t imm5 = Extract(word, kImm5);
+    unsigned int shift = 0;
+    while (shift < 4 && !(imm5 >> shift & 1)) {
+      shift++;
+    }
+
+    if (shift == 4 || (shift == 3 && !q)) {
+      return false;
+    }
+
+    instr.esize = 1 << shift;
+    instr.hasLane = Extract(word, kImm4) == 0;
+    instr.lane = imm5 >> (shift + 1);
+    return true;
+  }
+  case Opcode::MOVI:
+    return ResolveVectorImmediate(word, instr);
+  case Opcode::EXT:
+    if (!q && Extract(word, kImm4) >= 8) {
+      return false;
+    }
+    instr.hasImmediate = true;
+    instr.imm = Extract(word, kImm4);
+    return true;
+  case Opcode::TBL:
+    instr.count = Extract(word, kTableLength) + 1;
+    return true;
+  case Opcode::LD1:
+    switch (Extract(word, kLoadStoreOpcode)) {
+    case 0x7:
+      instr.count = 1;
+      break;
+    case 0xA:
+      instr.count = 2;
+      break;
+    case 0x6:
+      instr.count = 3;
+      break;
+    case 0x2:
+      instr.count = 4;
+      break;
+    default:
+      // LD2, LD3, LD4 and their stores
+      return false;
+    }
+
+    if (!Extract(word, kLoad)) {
+      instr.opcode = Opcode::ST1;
+    }
+
+    if (Extract(word, kPostIndex)) {
+      instr.writeback = true;
+      // Post-increment by the size of the list, rather than by a register, is encoded as rm == 31
+      if (instr.rm == 31) {
+        instr.hasImmediate = true;
+        instr.imm = instr.count * instr.size;
+      }
+    }
+    return true;
+  case Opcode::AESE:
+    instr.opcode = OffsetOpcode(Opcode::AESE, Extract(word, kCryptoOpcode));
+    return true;
+  case Opcode::SHA1C:
+    if (Extract(word, kShaOpcode) == 7) {
+      return false;
+    }
+    instr.opcode = OffsetOpcode(Opcode::SHA1C, Extract(word, kShaOpcode));
+    return true;
+  case Opcode::SHA1H:
+    if (Extract(word, kCryptoOpcode) == 3) {
+      return false;
+    }
+    instr.opcode = OffsetOpcode(Opcode::SHA1H, Extract(word, kCryptoOpcode));
+    return true;
+  case Opcode::SHA512H:
+    // RAX1 of the SHA3 extension
+    if (Extract(word, kSha512Opcode) == 3) {
+      return false;
+    }
+    instr.opcode =
+        OffsetOpcode(Opcode::SHA512H, Extract(word, kSha512Opcode));
+    return true;
+  case Opcode::PMULL:
+    // 8B to 8H, or 1D to 1Q, from the lower or, for PMULL2, the upper half of the source registers
+    switch (Extract(word, kVectorSize)) {
+    case 0:
+      instr.esize = 1;
+      break;
+    case 3:
+      instr.esize = 8;
+      break;
+    default:
+      return false;
+    }
+
+    if (q) {
+      instr.opcode = Opcode::PMULL2;
+    }
+    return true;
+  default:
+    return true;
+  }
+}
+
+/**
+ * Validate and resolve the fields of the scalable vector instructions. The element size is given by the size field,
+ * or by dtype for the loads and stores, and predicate destinations are 4-bit fields
+ *
+ * @return false if the encoding is unallocated, or one of the encodings of the class no lifter handles
+ */
+inline bool ResolveScalable(uint32_t word, Instruction& instr) {
+  uint32_t sizeIndex = Extract(word, kVectorSize);
+  instr.size = 8;
+  instr.esize = 1 << sizeIndex;
+
+  switch (instr.opcode) {
+  case Opcode::PTRUE:
+    instr.rd &= 15;
+    instr.pattern = Extract(word, kPattern);
+    return true;
+  case Opcode::WHILELT:
+    // WHILEGE to WHILEHI of SVE2
+    if (!Extract(word, kWhileLessThan)) {
+      return false;
+    }
+    instr.opcode = OffsetOpcode(Opcode::WHILELT,
+                                Extract(word, kWhileUnsigned) * 2 +
+                                    Extract(word, kWhileEqual));
+    instr.size = Extract(word, kWhileSf) ? 8 : 4;
+    instr.rd &= 15;
+    return true;
+  case Opcode::CNTB: {
+    bool increment = Extract(word, kElementCountIncrement);
+    bool decrement = Extract(word, kElementCountDecrement);
+    if (decrement && !increment) {
+      return false;
+    }
+
+    instr.opcode =
+        OffsetOpcode(Opcode::CNTB, (increment + decrement) * 4 + sizeIndex);
+    instr.pattern = Extract(word, kPattern);
+    // Multiplier of the element count
+    instr.hasImmediate = true;
+    instr.imm = Extract(word, kElementCountImm) + 1;
+    return true;
+  }
+  case Opcode::LD1B:
+  case Opcode::ST1B: {
+    // Only the forms whose memory element size is that of the vector elements, the others extend or truncate
+    uint32_t dtype = Extract(word, kScalableDtype);
+    if (dtype % 5 != 0) {
+      return false;
+    }
+
+    instr.opcode = OffsetOpcode(instr.opcode, dtype / 5);
+    instr.esize = 1 << (dtype / 5);
+    if (Extract(word, kScalableImmediateForm)) {
+      // Signed offset in multiples of the vector length
+      instr.hasImmediate = true;
+      instr.imm = (Extract(word, kScalableImm4) ^ 8ull) - 8;
+    } else if (instr.rm == 31) {
+      return false;
+    }
+    return true;
+  }
+  case Opcode::ZADD:
+    instr.opcode = OffsetOpcode(Opcode::ZADD, Extract(word, kScalableSub));
+    return true;
+  case Opcode::ZADDM:
+    // Zdn is both the destination and the first source, Zm is in the field of Zn
+    instr.opcode =
+        OffsetOpcode(Opcode::ZADDM, Extract(word, kScalablePredicatedSub));
+    instr.rm = instr.rn;
+    instr.rn = instr.rd;
+    return true;
+  case Opcode::CMPHS: {
+    bool op = Extract(word, kCompareOp);
+    bool o2 = Extract(word, kCompareO2);
+    // Compares with wide elements
+    if (!op && o2) {
+      return false;
+    }
+
+    Opcode first = !op ? Opcode::CMPHS : o2 ? Opcode::CMPEQ : Opcode::CMPGE;
+    instr.opcode = OffsetOpcode(first, Extract(word, kCompareNe));
+    instr.rd &= 15;
+    return true;
+  }
+  case Opcode::CMPLT: {
+    bool op = Extract(word, kCompareOp);
+    bool o2 = Extract(word, kCompareO2);
+    if (op && o2) {
+      return false;
+    }
+
+    Opcode first = op ? Opcode::CMPEQ : o2 ? Opcode::CMPLT : Opcode::CMPGE;
+    instr.opcode = OffsetOpcode(first, Extract(word, kCompareNe));
+    instr.rd &= 15;
+    instr.hasImmediate = true;
+    instr.imm = (Extract(word, kCompareImm) ^ 16ull) - 16;
+    return true;
+  }
+  default:
+    return true;
+  }
+}
+
+/**
+ * Validate the decoded fields and resolve the preferred alias, the same way the disassembly would print it
+ *
+ * @return false if the encoding is unallocated, or one of the encodings of the class no lifter handles
+ */
+inline bool ResolveAlias(uint32_t word, Instruction& instr) {
+  if (IsVectorOpcode(instr.opcode)) {
+    return ResolveVector(word, instr);
+  } else if (IsScalableOpcode(instr.opcode)) {
+    return ResolveScalable(word, instr);
+  }
+
+  unsigned int bits = instr.size * 8;
+
+  switch (instr.opcode) {
+  case Opcode::CSINC:
+    if (instr.rn == instr.rm && instr.cond != Condition::AL &&
+        instr.cond != Condition::NV) {
+      instr.opcode = instr.rn == 31 ? Opcode::CSET : Opcode::CINC;
+      instr.cond = InvertCondition(instr.cond);
+    }
+    return true;
+  case Opcode::CSINV:
+    if (instr.rn == instr.rm && instr.cond != Condition::AL &&
+        instr.cond != Condition::NV) {
+      instr.opcode = instr.rn == 31 ? Opcode::CSETM : Opcode::CINV;
+      instr.cond = InvertCondition(instr.cond);
+    }
+    return true;
+  case Opcode::CSNEG:
+    if (instr.rn == instr.rm && instr.cond != Condition::AL &&
+        instr.cond != Condition::NV) {
+      instr.opcode = Opcode::CNEG;
+      instr.cond = InvertCondition(instr.cond);
+    }
+    return true;
+  case Opcode::MADD:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::MUL;
+    }
+    return true;
+  case Opcode::MSUB:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::MNEG;
+    }
+    return true;
+  case Opcode::SMADDL:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::SMULL;
+    }
+    return true;
+  case Opcode::SMSUBL:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::SMNEGL;
+    }
+    return true;
+  case Opcode::UMADDL:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::UMULL;
+    }
+    return true;
+  case Opcode::UMSUBL:
+    if (instr.ra == 31) {
+      instr.opcode = Opcode::UMNEGL;
+    }
+    return true;
+  case Opcode::BFM:
+    if (Extract(word, kN) != (instr.size == 8) ||
+        instr.immr >= bits || instr.imms >= bits) {
+      return false;
+    }
+
+    if (instr.imms < instr.immr) {
+      instr.opcode = Opcode::BFI;
+      instr.lsb = (bits - instr.immr) & (bits - 1);
+      instr.width = instr.imms + 1;
+    } else {
+      instr.opcode = Opcode::BFXIL;
+      instr.lsb = instr.immr;
+      instr.width = instr.imms - instr.immr + 1;
+    }
+    return true;
+  case Opcode::UBFM:
+    if (Extract(word, kN) != (instr.size == 8) ||
+        instr.immr >= bits || instr.imms >= bits) {
+      return false;
+    }
+
+    if (instr.imms != bits - 1 && instr.imms + 1 == instr.immr) {
+      instr.opcode = Opcode::LSL;
+      instr.hasImmediate = true;
+      instr.imm = bits - 1 - instr.imms;
+    } else if (instr.imms == bits - 1) {
+      instr.opcode = Opcode::LSR;
+      instr.hasImmediate = true;
+      instr.imm = instr.immr;
+    } else if (instr.imms < instr.immr) {
+      instr.opcode = Opcode::UBFIZ;
+      instr.lsb = (bits - instr.immr) & (bits - 1);
+      instr.width = instr.imms + 1;
+    } else if (instr.size == 4 && instr.immr == 0 &&
+               (instr.imms == 7 || instr.imms == 15)) {
+      instr.opcode = instr.imms == 7 ? Opcode::UXTB : Opcode::UXTH;
+      instr.lsb = 0;
+      instr.width = instr.imms + 1;
+    } else {
+      instr.opcode = Opcode::UBFX;
+      instr.lsb = instr.immr;
+      instr.width = instr.imms - instr.immr + 1;
+    }
+    return true;
+  case Opcode::SBFM:
+    if (Extract(word, kN) != (instr.size == 8) ||
+        instr.immr >= bits || instr.imms >= bits) {
+      return false;
+    }
+
+    if (instr.imms == bits - 1) {
+      instr.opcode = Opcode::ASR;
+      instr.hasImmediate = true;
+      instr.imm = instr.immr;
+    } else if (instr.imms < instr.immr) {
+      instr.opcode = Opcode::SBFIZ;
+      instr.lsb = (bits - instr.immr) & (bits - 1);
+      instr.width = instr.imms + 1;
+    } else if (instr.immr == 0 && (instr.imms == 7 || instr.imms == 15 ||
+                                   (instr.size == 8 && instr.imms == 31))) {
+      instr.opcode = instr.imms == 7    ? Opcode::SXTB
+                     : instr.imms == 15 ? Opcode::SXTH
+                                        : Opcode::SXTW;
+      instr.lsb = 0;
+      instr.width = instr.imms + 1;
+    } else {
+      instr.opcode = Opcode::SBFX;
+      instr.lsb = instr.immr;
+      instr.width = instr.imms - instr.immr + 1;
+    }
+    return true;
+  case Opcode::EXTR:
+    if (Extract(word, kN) != (instr.size == 8) || instr.imms >= bits) {
+      return false;
+    }
+
+    if (instr.rn == instr.rm) {
+      instr.opcode = Opcode::ROR;
+      instr.hasImmediate = true;
+      instr.imm = instr.imms;
+    }
+    return true;
+  case Opcode::RORV:
+    instr.opcode = Opcode::ROR;
+    return true;
+  case Opcode::ADRP: {
+    // Signed 21-bit page offset
+    uint64_t pages = Extract(word, kImmHi) << 2 | Extract(word, kImmLo);
+    instr.hasImmediate = true;
+    instr.imm = ((pages ^ 0x100000) - 0x100000) << 12;
+    return true;
+  }
+  case Opcode::ADD:
+    if (!Extract(word, kAddSubImmediateForm)) {
+      return instr.immr <= kShiftAsr && instr.imms < bits;
+    }
+
+    instr.hasImmediate = true;
+    instr.imm = static_cast<uint64_t>(Extract(word, kImm12))
+                << (Extract(word, kImm12Shift) * 12);
+    return true;
+  case Opcode::SUB:
+    return instr.immr <= kShiftAsr && instr.imms < bits;
+  case Opcode::SUBS:
+    if (Extract(word, kAddSubImmediateForm)) {
+      instr.hasImmediate = true;
+      instr.imm = static_cast<uint64_t>(Extract(word, kImm12))
+                  << (Extract(word, kImm12Shift) * 12);
+    } else if (instr.imms >= bits) {
+      return false;
+    }
+
+    if (instr.rd == 31) {
+      instr.opcode = Opcode::CMP;
+    }
+    return true;
+  case Opcode::CCMN:
+    if (Extract(word, kConditionalCompareOp)) {
+      instr.opcode = Opcode::CCMP;
+    }
+    if (Extract(word, kConditionalCompareImmediateForm)) {
+      instr.hasImmediate = true;
+      instr.imm = instr.rm;
+    }
+    return true;
+  case Opcode::BCOND: {
+    // B.AL and B.NV are unconditional, and left to the base lifter
+    if (instr.cond == Condition::AL || instr.cond == Condition::NV) {
+      return false;
+    }
+
+    // Signed 19-bit instruction offset
+    uint64_t offset = Extract(word, kImm19);
+    instr.hasImmediate = true;
+    instr.imm = ((offset ^ 0x40000) - 0x40000) << 2;
+    return true;
+  }
+  case Opcode::LDR:
+    instr.size = 1 << Extract(word, kLoadStoreSize);
+    instr.hasImmediate = true;
+    instr.imm = Extract(word, kImm12) * instr.size;
+    return true;
+  case Opcode::MOVZ:
+  case Opcode::MOVN:
+  case Opcode::MOVK:
+    if (instr.size == 4 && Extract(word, kHw) >= 2) {
+      return false;
+    }
+    instr.lsb = Extract(word, kHw) * 16;
+    instr.width = 16;
+    instr.hasImmediate = true;
+    instr.imm = static_cast<uint64_t>(Extract(word, kImm16)) << instr.lsb;
+    return true;
+  case Opcode::LDADD:
+    instr.opcode = OffsetOpcode(Opcode::LDADD, Extract(word, kAtomicOpcode));
+    // Fall through
+  case Opcode::SWP:
+    instr.size = 1 << Extract(word, kLoadStoreSize);
+    instr.order = Extract(word, kAtomicAcquire) * kOrderAcquire |
+                  Extract(word, kAtomicRelease) * kOrderRelease;
+    return true;
+  case Opcode::CAS:
+    instr.size = 1 << Extract(word, kLoadStoreSize);
+    instr.order = Extract(word, kCasAcquire) * kOrderAcquire |
+                  Extract(word, kExclusiveOrdered) * kOrderRelease;
+    return true;
+  case Opcode::LDXR:
+    instr.size = 1 << Extract(word, kLoadStoreSize);
+    instr.order = Extract(word, kExclusiveOrdered) * kOrderAcquire;
+    return true;
+  case Opcode::STXR:
+    instr.size = 1 << Extract(word, kLoadStoreSize);
+    instr.order = Extract(word, kExclusiveOrdered) * kOrderRelease;
+    return true;
+  case Opcode::CRC32B:
+    // Only CRC32X and CRC32CX take an X register, the accumulator always is a W register
+    if ((Extract(word, kCrcSize) == 3) != (instr.size == 8)) {
+      return false;
+    }
+    instr.opcode = OffsetOpcode(Opcode::CRC32B,
+                                Extract(word, kCrcPolynomial) * 4 +
+                                    Extract(word, kCrcSize));
+    instr.size = 4;
+    return true;
+  case Opcode::PACIA:
+    // Hint forms: PACIA1716 and the like on X17 with X16, PACIASP on X30 with SP and PACIAZ on X30 with zero
+    if ((word & 0xFFFFF01F) == 0xD503201F) {
+      uint32_t op2 = Extract(word, kHintOp2);
+      instr.opcode = OffsetOpcode(Opcode::PACIA, (op2 & 4) + (op2 >> 1 & 1));
+      if (Extract(word, kHintCrm) == 1) {
+        instr.rd = 17;
+        instr.rn = 16;
+      } else {
+        instr.rd = 30;
+        instr.rn = 31;
+        instr.hasImmediate = (op2 & 1) == 0;
+      }
+      return true;
+    }
+
+    instr.opcode = OffsetOpcode(Opcode::PACIA, Extract(word, kPacOpcode));
+    // PACIZA to AUTDZB
+    if (Extract(word, kPacZero)) {
+      if (instr.rn != 31) {
+        return false;
+      }
+      instr.hasImmediate = true;
+    }
+    return true;
+  case Opcode::XPACI:
+    if (word == 0xD50320FF) {
+      // XPACLRI
+      instr.rd = 30;
+    } else if (Extract(word, kXpacData)) {
+      instr.opcode = Opcode::XPACD;
+    }
+    return true;
+  case Opcode::RETAA:
+    // Authenticates X30 with SP
+    instr.opcode = OffsetOpcode(Opcode::RETAA, Extract(word, kBranchKey));
+    instr.rn = 30;
+    instr.rm = 31;
+    return true;
+  case Opcode::BRAA:
+    // BRAAZ to BLRABZ authenticate with zero
+    if (!Extract(word, kBranchModifier)) {
+      if (instr.rm != 31) {
+        return false;
+      }
+      instr.hasImmediate = true;
+    }
+    instr.opcode = OffsetOpcode(Opcode::BRAA, Extract(word, kBranchLink) * 2 +
+                                                  Extract(word, kBranchKey));
+    return true;
+  default:
+    return true;
+  }
+}
+
+/**
+ * Returns true for the branches to a register, RET, ERET and the authenticated branches included
+ */
+constexpr bool IsBranchToRegister(uint32_t word) {
+  return (word & 0xFE000000) == 0xD6000000;
+}
+
+/**
+ * Returns true for the branch instructions, which end the straight-line run of instructions that follows them
+ */
+constexpr bool IsBranch(uint32_t word) {
+  // B and BL, CBZ and CBNZ, TBZ and TBNZ, B.cond, and the branches to a register
+  return (word & 0x7C000000) == 0x14000000 ||
+         (word & 0x7E000000) == 0x34000000 ||
+         (word & 0x7E000000) == 0x36000000 ||
+         (word & 0xFF000010) == 0x54000000 || IsBranchToRegister(word);
+}
+
+/**
+ * Read-modify-write step of an exclusive load/store loop, the instruction between the load and the store, resolved to
+ * the LSE atomic the loop is equivalent to
+ */
+struct ExclusiveOperation {
+  // LDADD, LDCLR, LDEOR, LDSET or SWP
+  Opcode atomic;
+  uint8_t size;
+  uint8_t rd;
+  // Operand read along with the loaded value, 31 for the MOV of SWP. Register 31 is the zero register, ADD and SUB
+  // (immediate) from or to the stack pointer are not decoded
+  uint8_t rn;
+  uint8_t rm;
+  // The other operand is imm rather than rm, already negated for SUB
+  bool hasImmediate;
+  uint64_t imm;
+  // SUB (register): the operand of LDADD is -rm
+  bool negate;
+};
+
+/**
+ * Decode the read-modify-write step of an exclusive loop: ADD and SUB (immediate), and ADD, SUB, AND, ORR, EOR and MOV
+ * of unshifted registers. Flag-setting forms are not decoded, flags are not written by the atomics
+ *
+ * @return false for any other instruction
+ */
+inline bool DecodeExclusiveOperation(uint32_t word, ExclusiveOperation& op) {
+  op = ExclusiveOperation();
+  op.size = Extract(word, kSf) ? 8 : 4;
+  op.rd = Extract(word, {0, 5});
+  op.rn = Extract(word, {5, 5});
+  op.rm = Extract(word, {16, 5});
+
+  // ADD and SUB (immediate)
+  switch (word & 0x7F800000) {
+  case 0x11000000:
+  case 0x51000000: {
+    if (op.rd == 31 || op.rn == 31) {
+      return false;
+    }
+
+    uint64_t imm = static_cast<uint64_t>(Extract(word, kImm12))
+                   << (Extract(word, kImm12Shift) * 12);
+    if (word & 0x40000000) {
+      imm = op.size == 8 ? 0 - imm : (0 - imm) & 0xFFFFFFFF;
+    }
+
+    op.atomic = Opcode::LDADD;
+    op.hasImmediate = true;
+    op.imm = imm;
+    return true;
+  }
+  default:
+    break;
+  }
+
+  // Shifted register forms without a shift
+  switch (word & 0x7FE0FC00) {
+  case 0x0B000000:
+    op.atomic = Opcode::LDADD;
+    return true;
+  case 0x4B000000:
+    op.atomic = Opcode::LDADD;
+    op.negate = true;
+    return true;
+  case 0x0A000000:
+    op.atomic = Opcode::LDCLR;
+    return true;
+  case 0x2A000000:
+    op.atomic = op.rn == 31 ? Opcode::SWP : Opcode::LDSET;
+    return true;
+  case 0x4A000000:
+    op.atomic = Opcode::LDEOR;
+    return true;
+  default:
+    return false;
+  }
+}
+
+/**
+ * Decode an instruction word against a subset of the encoding classes
+ *
+ * @param word little-endian instruction word
+ * @param instr decoded instruction
+ * @param classes encoding classes to match, in kEncodingClasses order
+ * @param count number of classes
+ * @return false if the word does not belong to any of the classes
+ */
+inline bool Decode(uint32_t word, Instruction& instr,
+                   const EncodingClass* classes, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    const EncodingClass& encoding = classes[i];
+    if ((word & encoding.mask) != encoding.value) {
+      continue;
+    }
+
+    const Layout& layout = kLayouts[encoding.layout];
+
+    instr = Instruction();
+    instr.opcode = encoding.opcode;
+    instr.size = Extract(word, kSf) ? 8 : 4;
+    instr.rd = Extract(word, layout.rd);
+    instr.rn = Extract(word, layout.rn);
+    instr.rm = Extract(word, layout.rm);
+    instr.ra = Extract(word, layout.ra);
+    instr.cond = static_cast<Condition>(Extract(word, layout.cond));
+    instr.immr = Extract(word, layout.immr);
+    instr.imms = Extract(word, layout.imms);
+
+    return ResolveAlias(word, instr);
+  }
+
+  return false;
+}
+
+/**
+ * Decode an instruction word
+ *
+ * @param word little-endian instruction word
+ * @param instr decoded instruction
+ * @return false if the word does not belong to any of the known encoding classes
+ */
+inline bool Decode(uint32_t word, Instruction& instr) {
+  return Decode(word, instr, kEncodingClasses, kEncodingClassCount);
+}
+
+} // namespace aarch64
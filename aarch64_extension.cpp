@@ -1,12 +1,32 @@
+#include <algorithm>
+#include <atomic>
 #include <binaryninjaapi.h>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "aarch64_decode_cache.h"
+#include "aarch64_decode_store.h"
+#include "aarch64_decoder.h"
+#include "aarch64_intrinsics.h"
+#include "aarch64_prescan.h"
+#include "aarch64_sequence.h"
+#include "aarch64_stats.h"
+#include "aarch64_trace.h"
+
+#ifdef AARCH64_CAPSTONE_CROSSCHECK
 #include <capstone/capstone.h>
+#endif
 
 using namespace BinaryNinja;
 
-// #define AARCH64_TRACE_INSTR
-
 // Returns 1s expanded to count, e.g.: Count<uint8_t>(7) == 0b01111111
-template <typename T> inline T Ones(size_t count) {
+template <typename T> constexpr T Ones(size_t count) {
   if (count == sizeof(T) * 8) {
     return static_cast<T>(~static_cast<T>(0));
   } else {
@@ -14,9 +34,12 @@ template <typename T> inline T Ones(size_t count) {
   }
 }
 
+#ifdef AARCH64_CAPSTONE_CROSSCHECK
 class Disassembler {
 private:
   csh mCapstone {};
+  // Preallocated once and reused by every Disassemble() call, so that the hot path never touches the allocator
+  cs_insn* mInstruction = nullptr;
   bool mIsOK = true;
 public:
   Disassembler() noexcept {
@@ -26,12 +49,23 @@ public:
     }
 
     cs_option(mCapstone, CS_OPT_DETAIL, CS_OPT_ON);
+
+    mInstruction = cs_malloc(mCapstone);
+    if (mInstruction == nullptr) {
+      mIsOK = false;
+    }
   }
 
   ~Disassembler() {
+    if (mInstruction != nullptr) {
+      cs_free(mInstruction, 1);
+    }
     cs_close(&mCapstone);
   }
 
+  Disassembler(const Disassembler&) = delete;
+  Disassembler& operator=(const Disassembler&) = delete;
+
   bool IsOK() const {
     return mIsOK;
   }
@@ -39,335 +73,4122 @@ public:
   csh Get() const {
     return mCapstone;
   }
-};
 
-// Disassembler _must_ be thread_local because on multi-threaded analysis GetInstructionLowLevelIL may be called
-// from multiple threads, thus causing Capstone to malfunction. Note that on thread exit the destructor will
-// be called and the associated Capstone resources will be released
-static thread_local Disassembler disassembler;
-
-class AArch64ArchitectureExtension : public ArchitectureHook {
-private:
   /**
-   * Convert a Capstone condition code to BNIL condition code
+   * Disassemble a single instruction into the preallocated instruction buffer
    *
-   * @param condition AArch64 condition code
-   * @return BNIL condition, or -1
+   * @param data instruction bytes
+   * @param len number of bytes available at data
+   * @param addr address of the instruction
+   * @return decoded instruction owned by the disassembler and overwritten by the next call, or nullptr if the bytes
+   * could not be decoded
    */
-  static BNLowLevelILFlagCondition LiftCondition(arm64_cc condition) {
-    switch (condition) {
-    case ARM64_CC_EQ:
-      return LLFC_E;
-    case ARM64_CC_NE:
-      return LLFC_NE;
-    case ARM64_CC_HS:
-      return LLFC_UGE;
-    case ARM64_CC_LO:
-      return LLFC_ULE;
-    case ARM64_CC_MI:
-      return LLFC_NEG;
-    case ARM64_CC_PL:
-      return LLFC_POS;
-    case ARM64_CC_VS:
-      return LLFC_O;
-    case ARM64_CC_VC:
-      return LLFC_NO;
-    case ARM64_CC_HI:
-      return LLFC_UGE;
-    case ARM64_CC_LS:
-      return LLFC_ULE;
-    case ARM64_CC_GE:
-      return LLFC_SGE;
-    case ARM64_CC_LT:
-      return LLFC_SLT;
-    case ARM64_CC_GT:
-      return LLFC_SGT;
-    case ARM64_CC_LE:
-      return LLFC_SLE;
-    case ARM64_CC_INVALID:
-      return (BNLowLevelILFlagCondition) ARM64_CC_INVALID;
-    case ARM64_CC_AL:
-      return (BNLowLevelILFlagCondition) ARM64_CC_AL;
-    case ARM64_CC_NV:
-      return (BNLowLevelILFlagCondition) ARM64_CC_NV;
+  cs_insn* Disassemble(const uint8_t* data, size_t len, uint64_t addr) {
+    if (!mIsOK ||
+        !cs_disasm_iter(mCapstone, &data, &len, &addr, mInstruction)) {
+      return nullptr;
     }
 
-    return (BNLowLevelILFlagCondition) -1;
+    return mInstruction;
   }
+};
 
-public:
-  explicit AArch64ArchitectureExtension(Architecture* aarch64)
-      : ArchitectureHook(aarch64) {
+// Capstone instruction id the native decoder is expected to agree with
+static unsigned int GetCapstoneId(aarch64::Opcode opcode) {
+  switch (opcode) {
+  case aarch64::Opcode::CSEL:
+    return ARM64_INS_CSEL;
+  case aarch64::Opcode::CSINC:
+    return ARM64_INS_CSINC;
+  case aarch64::Opcode::CINC:
+    return ARM64_INS_CINC;
+  case aarch64::Opcode::CSET:
+    return ARM64_INS_CSET;
+  case aarch64::Opcode::CSINV:
+    return ARM64_INS_CSINV;
+  case aarch64::Opcode::CINV:
+    return ARM64_INS_CINV;
+  case aarch64::Opcode::CSETM:
+    return ARM64_INS_CSETM;
+  case aarch64::Opcode::CSNEG:
+    return ARM64_INS_CSNEG;
+  case aarch64::Opcode::CNEG:
+    return ARM64_INS_CNEG;
+  case aarch64::Opcode::MADD:
+    return ARM64_INS_MADD;
+  case aarch64::Opcode::MUL:
+    return ARM64_INS_MUL;
+  case aarch64::Opcode::MSUB:
+    return ARM64_INS_MSUB;
+  case aarch64::Opcode::MNEG:
+    return ARM64_INS_MNEG;
+  case aarch64::Opcode::SMADDL:
+    return ARM64_INS_SMADDL;
+  case aarch64::Opcode::SMULL:
+    return ARM64_INS_SMULL;
+  case aarch64::Opcode::SMSUBL:
+    return ARM64_INS_SMSUBL;
+  case aarch64::Opcode::SMNEGL:
+    return ARM64_INS_SMNEGL;
+  case aarch64::Opcode::UMADDL:
+    return ARM64_INS_UMADDL;
+  case aarch64::Opcode::UMULL:
+    return ARM64_INS_UMULL;
+  case aarch64::Opcode::UMSUBL:
+    return ARM64_INS_UMSUBL;
+  case aarch64::Opcode::UMNEGL:
+    return ARM64_INS_UMNEGL;
+  case aarch64::Opcode::SMULH:
+    return ARM64_INS_SMULH;
+  case aarch64::Opcode::UMULH:
+    return ARM64_INS_UMULH;
+  case aarch64::Opcode::BFI:
+    return ARM64_INS_BFI;
+  case aarch64::Opcode::BFXIL:
+    return ARM64_INS_BFXIL;
+  case aarch64::Opcode::LSL:
+    return ARM64_INS_LSL;
+  case aarch64::Opcode::LSR:
+    return ARM64_INS_LSR;
+  case aarch64::Opcode::UBFIZ:
+    return ARM64_INS_UBFIZ;
+  case aarch64::Opcode::UBFX:
+    return ARM64_INS_UBFX;
+  case aarch64::Opcode::UXTB:
+    return ARM64_INS_UXTB;
+  case aarch64::Opcode::UXTH:
+    return ARM64_INS_UXTH;
+  case aarch64::Opcode::ASR:
+    return ARM64_INS_ASR;
+  case aarch64::Opcode::SBFIZ:
+    return ARM64_INS_SBFIZ;
+  case aarch64::Opcode::SBFX:
+    return ARM64_INS_SBFX;
+  case aarch64::Opcode::SXTB:
+    return ARM64_INS_SXTB;
+  case aarch64::Opcode::SXTH:
+    return ARM64_INS_SXTH;
+  case aarch64::Opcode::SXTW:
+    return ARM64_INS_SXTW;
+  case aarch64::Opcode::EXTR:
+    return ARM64_INS_EXTR;
+  case aarch64::Opcode::ROR:
+    return ARM64_INS_ROR;
+  case aarch64::Opcode::ADRP:
+    return ARM64_INS_ADRP;
+  case aarch64::Opcode::ADD:
+    return ARM64_INS_ADD;
+  case aarch64::Opcode::SUB:
+    return ARM64_INS_SUB;
+  case aarch64::Opcode::LDR:
+    return ARM64_INS_LDR;
+  case aarch64::Opcode::MOVZ:
+    return ARM64_INS_MOVZ;
+  case aarch64::Opcode::MOVN:
+    return ARM64_INS_MOVN;
+  case aarch64::Opcode::MOVK:
+    return ARM64_INS_MOVK;
+  case aarch64::Opcode::CRC32B:
+    return ARM64_INS_CRC32B;
+  case aarch64::Opcode::CRC32H:
+    return ARM64_INS_CRC32H;
+  case aarch64::Opcode::CRC32W:
+    return ARM64_INS_CRC32W;
+  case aarch64::Opcode::CRC32X:
+    return ARM64_INS_CRC32X;
+  case aarch64::Opcode::CRC32CB:
+    return ARM64_INS_CRC32CB;
+  case aarch64::Opcode::CRC32CH:
+    return ARM64_INS_CRC32CH;
+  case aarch64::Opcode::CRC32CW:
+    return ARM64_INS_CRC32CW;
+  case aarch64::Opcode::CRC32CX:
+    return ARM64_INS_CRC32CX;
+  case aarch64::Opcode::BR:
+    return ARM64_INS_BR;
+  case aarch64::Opcode::SUBS:
+    return ARM64_INS_SUBS;
+  case aarch64::Opcode::CMP:
+    return ARM64_INS_CMP;
+  case aarch64::Opcode::CCMP:
+    return ARM64_INS_CCMP;
+  case aarch64::Opcode::CCMN:
+    return ARM64_INS_CCMN;
+  case aarch64::Opcode::BCOND:
+    return ARM64_INS_B;
+  case aarch64::Opcode::VADD:
+    return ARM64_INS_ADD;
+  case aarch64::Opcode::VSUB:
+    return ARM64_INS_SUB;
+  case aarch64::Opcode::VAND:
+    return ARM64_INS_AND;
+  case aarch64::Opcode::VBIC:
+    return ARM64_INS_BIC;
+  case aarch64::Opcode::VORR:
+    return ARM64_INS_ORR;
+  case aarch64::Opcode::VMOV:
+    return ARM64_INS_MOV;
+  case aarch64::Opcode::VEOR:
+    return ARM64_INS_EOR;
+  case aarch64::Opcode::DUP:
+    return ARM64_INS_DUP;
+  case aarch64::Opcode::MOVI:
+    return ARM64_INS_MOVI;
+  case aarch64::Opcode::MVNI:
+    return ARM64_INS_MVNI;
+  case aarch64::Opcode::EXT:
+    return ARM64_INS_EXT;
+  case aarch64::Opcode::TBL:
+    return ARM64_INS_TBL;
+  case aarch64::Opcode::LD1:
+    return ARM64_INS_LD1;
+  case aarch64::Opcode::ST1:
+    return ARM64_INS_ST1;
+  case aarch64::Opcode::AESE:
+    return ARM64_INS_AESE;
+  case aarch64::Opcode::AESD:
+    return ARM64_INS_AESD;
+  case aarch64::Opcode::AESMC:
+    return ARM64_INS_AESMC;
+  case aarch64::Opcode::AESIMC:
+    return ARM64_INS_AESIMC;
+  case aarch64::Opcode::SHA1C:
+    return ARM64_INS_SHA1C;
+  case aarch64::Opcode::SHA1P:
+    return ARM64_INS_SHA1P;
+  case aarch64::Opcode::SHA1M:
+    return ARM64_INS_SHA1M;
+  case aarch64::Opcode::SHA1SU0:
+    return ARM64_INS_SHA1SU0;
+  case aarch64::Opcode::SHA256H:
+    return ARM64_INS_SHA256H;
+  case aarch64::Opcode::SHA256H2:
+    return ARM64_INS_SHA256H2;
+  case aarch64::Opcode::SHA256SU1:
+    return ARM64_INS_SHA256SU1;
+  case aarch64::Opcode::SHA1H:
+    return ARM64_INS_SHA1H;
+  case aarch64::Opcode::SHA1SU1:
+    return ARM64_INS_SHA1SU1;
+  case aarch64::Opcode::SHA256SU0:
+    return ARM64_INS_SHA256SU0;
+  case aarch64::Opcode::SHA512H:
+    return ARM64_INS_SHA512H;
+  case aarch64::Opcode::SHA512H2:
+    return ARM64_INS_SHA512H2;
+  case aarch64::Opcode::SHA512SU1:
+    return ARM64_INS_SHA512SU1;
+  case aarch64::Opcode::SHA512SU0:
+    return ARM64_INS_SHA512SU0;
+  case aarch64::Opcode::PMULL:
+    return ARM64_INS_PMULL;
+  case aarch64::Opcode::PMULL2:
+    return ARM64_INS_PMULL2;
+  case aarch64::Opcode::PTRUE:
+    return ARM64_INS_PTRUE;
+  case aarch64::Opcode::WHILELT:
+    return ARM64_INS_WHILELT;
+  case aarch64::Opcode::WHILELE:
+    return ARM64_INS_WHILELE;
+  case aarch64::Opcode::WHILELO:
+    return ARM64_INS_WHILELO;
+  case aarch64::Opcode::WHILELS:
+    return ARM64_INS_WHILELS;
+  case aarch64::Opcode::CNTB:
+    return ARM64_INS_CNTB;
+  case aarch64::Opcode::CNTH:
+    return ARM64_INS_CNTH;
+  case aarch64::Opcode::CNTW:
+    return ARM64_INS_CNTW;
+  case aarch64::Opcode::CNTD:
+    return ARM64_INS_CNTD;
+  case aarch64::Opcode::INCB:
+    return ARM64_INS_INCB;
+  case aarch64::Opcode::INCH:
+    return ARM64_INS_INCH;
+  case aarch64::Opcode::INCW:
+    return ARM64_INS_INCW;
+  case aarch64::Opcode::INCD:
+    return ARM64_INS_INCD;
+  case aarch64::Opcode::DECB:
+    return ARM64_INS_DECB;
+  case aarch64::Opcode::DECH:
+    return ARM64_INS_DECH;
+  case aarch64::Opcode::DECW:
+    return ARM64_INS_DECW;
+  case aarch64::Opcode::DECD:
+    return ARM64_INS_DECD;
+  case aarch64::Opcode::LD1B:
+    return ARM64_INS_LD1B;
+  case aarch64::Opcode::LD1H:
+    return ARM64_INS_LD1H;
+  case aarch64::Opcode::LD1W:
+    return ARM64_INS_LD1W;
+  case aarch64::Opcode::LD1D:
+    return ARM64_INS_LD1D;
+  case aarch64::Opcode::ST1B:
+    return ARM64_INS_ST1B;
+  case aarch64::Opcode::ST1H:
+    return ARM64_INS_ST1H;
+  case aarch64::Opcode::ST1W:
+    return ARM64_INS_ST1W;
+  case aarch64::Opcode::ST1D:
+    return ARM64_INS_ST1D;
+  case aarch64::Opcode::ZADD:
+  case aarch64::Opcode::ZADDM:
+    return ARM64_INS_ADD;
+  case aarch64::Opcode::ZSUB:
+  case aarch64::Opcode::ZSUBM:
+    return ARM64_INS_SUB;
+  case aarch64::Opcode::CMPEQ:
+    return ARM64_INS_CMPEQ;
+  case aarch64::Opcode::CMPNE:
+    return ARM64_INS_CMPNE;
+  case aarch64::Opcode::CMPGE:
+    return ARM64_INS_CMPGE;
+  case aarch64::Opcode::CMPGT:
+    return ARM64_INS_CMPGT;
+  case aarch64::Opcode::CMPHS:
+    return ARM64_INS_CMPHS;
+  case aarch64::Opcode::CMPHI:
+    return ARM64_INS_CMPHI;
+  case aarch64::Opcode::CMPLT:
+    return ARM64_INS_CMPLT;
+  case aarch64::Opcode::CMPLE:
+    return ARM64_INS_CMPLE;
+  default:
+    return ARM64_INS_INVALID;
+  }
+}
+
+// Capstone register of a general purpose register field. Translated by enumeration rather than by name, so that the
+// crosscheck also works with a diet Capstone, which has no register names
+static unsigned int GetCapstoneRegister(size_t size, uint8_t reg,
+                                        bool stackPointer) {
+  if (reg == 31) {
+    if (stackPointer) {
+      return size == 8 ? ARM64_REG_SP : ARM64_REG_WSP;
+    }
+
+    return size == 8 ? ARM64_REG_XZR : ARM64_REG_WZR;
+  }
+
+  if (size == 4) {
+    return ARM64_REG_W0 + reg;
+  }
+
+  // X29 and X30 are numbered apart from the other X registers
+  switch (reg) {
+  case 29:
+    return ARM64_REG_X29;
+  case 30:
+    return ARM64_REG_X30;
+  default:
+    return ARM64_REG_X0 + reg;
+  }
+}
+#endif
+
+/**
+ * Mutable state of a thread that decodes AArch64 instructions. Everything else, the register tables, the lifter
+ * registry and the settings, is built once and shared read-only by all threads
+ */
+struct ThreadState {
+  // Instructions are decoded through a per-thread cache, since analysis asks about the same address several times:
+  // for instruction info, for text and for lifting, and again on every reanalysis
+  aarch64::DecodeCache decodeCache;
+  // Register constants of the instruction sequence being lifted, for the idioms spread over several instructions
+  aarch64::SequenceTracker sequence;
+  // Always-on lift counters, aggregated without locks when reported
+  aarch64::ThreadStatistics statistics;
+  // Union of the decode stores of the open databases, refreshed from the registry when its generation changes
+  std::shared_ptr<const aarch64::DecodeStore> store;
+  uint64_t storeGeneration = 0;
+  // Prescan bitmap of the view of the IL function being lifted, looked up again when the function or the registry
+  // generation changes. The reference keeps another IL function from being allocated at the same address while the
+  // bitmap is cached, and is released once the thread lifts another function
+  Ref<LowLevelILFunction> prescanFunction;
+  uint64_t prescanGeneration = 0;
+  std::shared_ptr<const aarch64::PrescanBitmap> prescan;
+  // Sampled lift events, only allocated once tracing samples a call on this thread
+  std::unique_ptr<aarch64::ThreadTrace> trace;
+  // Outcome of the last LiftInstruction call, for the trace
+  aarch64::Opcode liftOpcode = aarch64::Opcode::Invalid;
+  bool liftFallback = false;
+  // Bytes the core handed over past the instruction being lifted, for the lifters that match the instructions ahead
+  const uint8_t* following = nullptr;
+  size_t followingLength = 0;
+  // Instruction word being lifted
+  uint32_t word = 0;
+  // Bytes read from the view past a decode cache miss, to decode ahead
+  std::vector<uint8_t> prefetchBytes;
+#ifdef AARCH64_CAPSTONE_CROSSCHECK
+  // Capstone _must_ be used from a single thread, as GetInstructionLowLevelIL is called from every analysis thread
+  Disassembler disassembler;
+#endif
+};
+
+// Trivially initialized, so that reading it costs no initialization check and threads that never decode an AArch64
+// instruction, e.g. the analysis workers of other architectures, never allocate their state
+static thread_local ThreadState* threadState = nullptr;
+
+/**
+ * Releases the state of a thread, and unregisters its statistics, on thread exit. The pointer is cleared first, so
+ * that it never refers to a destroyed state
+ */
+struct ThreadStateOwner {
+  std::unique_ptr<ThreadState> state;
+
+  ~ThreadStateOwner() {
+    threadState = nullptr;
+    state.reset();
   }
+};
+
+static ThreadState& CreateThreadState() {
+  static thread_local ThreadStateOwner owner;
+  owner.state.reset(new ThreadState());
+  threadState = owner.state.get();
+  return *threadState;
+}
+
+/**
+ * State of the current thread, created on the first instruction it decodes
+ */
+static inline ThreadState& GetThreadState() {
+  return threadState != nullptr ? *threadState : CreateThreadState();
+}
+
+class AArch64ArchitectureExtension : public ArchitectureHook {
+private:
+  /**
+   * Binary Ninja register resolved from an instruction register field
+   */
+  struct RegisterOperand {
+    uint32_t id;
+    size_t size;
+  };
+
+  // General purpose registers indexed by [size == 8][register number], where register number 31 is the zero register.
+  // Built once when the extension is created and never modified afterwards, so it is safe to read from any analysis
+  // thread
+  RegisterOperand mGeneralRegisters[2][32];
+  // Stack pointers indexed by [size == 8], for the instructions where register number 31 is the stack pointer
+  RegisterOperand mStackPointers[2];
+  // SIMD&FP registers indexed by [size == 16][register number], the D and the Q view of each register
+  RegisterOperand mVectorRegisters[2][32];
+  // NZCV flags, set by the comparisons and by the loop control of the scalable vector extension. Both are left out if
+  // the base architecture lacks any of them
+  bool mConditionFlags = false;
+  uint32_t mNegativeFlag = 0;
+  uint32_t mZeroFlag = 0;
+  uint32_t mCarryFlag = 0;
+  uint32_t mOverflowFlag = 0;
+  // Flag write type of the base architecture setting all the flags, the comparisons are left out without it
+  bool mComparisons = false;
+  uint32_t mFlagWriteAll = 0;
+  // Z and P registers of the scalable vector extension. Only resolved if the base architecture has them, the scalable
+  // vector lifters are left out otherwise
+  bool mScalable = false;
+  RegisterOperand mScalableRegisters[32];
+  RegisterOperand mPredicateRegisters[16];
+
+  // Intrinsic ids of the extension start at this offset, far above the ids of the base architecture
+  static constexpr uint32_t kIntrinsicBase = 0x40000000;
+
+  // Lift conditional selects as straight-line arithmetic rather than If/Goto blocks, see LiftConditionalSelect
+  bool mFlatConditionalSelect = false;
+  // Count the cycles spent in each lifter
+  bool mTimeLifters = false;
+  // Lift the pointer signing, authentication and stripping instructions as no-ops, see LiftPointerAuth
+  bool mPointerAuthNop = false;
+  // Leave out the flags of a comparison only read by the conditional select right after it, see LiftSUBS
+  bool mElideFlagWrites = false;
+  // Number of instructions decoded ahead of a decode cache miss
+  size_t mPrefetchDepth = 16;
+  // Look decode cache misses up in the decode stores loaded from the databases
+  bool mPersistDecodes = false;
+  // Skip decoding the words the prescan of the view found no encoding class for
+  bool mPrescan = false;
+  // Write notifications of the prescanned views, unregistered when their view is destroyed
+  std::mutex mPrescanMutex;
+  std::vector<std::pair<const void*, BinaryDataNotification*>>
+      mPrescanNotifications;
+  // Record one in this many lift calls of each thread in its trace, 0 when tracing is disabled
+  uint32_t mTraceInterval = 0;
 
-  bool LiftCSINC(cs_insn* instr, LowLevelILFunction& il) {
-    cs_arm64* detail = &(instr->detail->arm64);
+  // Metadata key of the decode store of a database
+  static constexpr const char* kDecodeStoreKey = "aarch64ext.decodeStore";
+  // Instruction slots per prescan chunk, the unit of work of the scan threads: 1 MiB of instructions
+  static constexpr size_t kPrescanChunkSlots = 256 * 1024;
 
-    if (detail->op_count != 3) {
+  typedef bool (AArch64ArchitectureExtension::*Lifter)(
+      const aarch64::Instruction& instr, LowLevelILFunction& il);
+
+  /**
+   * Lifter registry entry
+   */
+  struct LifterRegistration {
+    // Instruction or alias handled by the lifter
+    aarch64::Opcode opcode;
+    // Opcode of the encoding class the instruction is decoded from, aliases share the class of their instruction
+    aarch64::Opcode encoding;
+    Lifter lift;
+    // 64-bit specialization of a width templated lifter, which lift is then the 32-bit one of. The width is told by
+    // the sf bit, so the specializations work on constant sizes and masks. nullptr when lift handles both widths
+    Lifter lift64 = nullptr;
+  };
+
+  // Enabled lifters indexed by whether the instruction is 64-bit and by opcode, nullptr for the instructions left to
+  // the base lifter. Both widths are set for the enabled opcodes. Built by LoadSettings
+  Lifter mLifters[2][aarch64::kOpcodeCount] {};
+  // Encoding classes of the enabled lifters, the only ones decoded. Words of any other class are passed to the base
+  // lifter without being decoded
+  aarch64::EncodingClass mEncodingClasses[aarch64::kEncodingClassCount];
+  size_t mEncodingClassCount = 0;
+
+  // Register tables and lifters are built on the first call for an AArch64 view rather than at startup, see
+  // EnsureInitialized
+  std::once_flag mInitializeOnce;
+  std::atomic<bool> mInitialized {false};
+
+  bool FindRegister(const char* name, RegisterOperand& reg) {
+    reg.id = this->m_base->GetRegisterByName(name);
+    if (reg.id == BN_INVALID_REGISTER) {
       return false;
     }
 
-    uint32_t Rd = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[0].reg));
-    uint32_t Rn = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[1].reg));
-    uint32_t Rm = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[2].reg));
-    size_t Rd_size = this->m_base->GetRegisterInfo(Rd).size;
-    size_t Rn_size = this->m_base->GetRegisterInfo(Rn).size;
-    size_t Rm_size = this->m_base->GetRegisterInfo(Rm).size;
+    reg.size = this->m_base->GetRegisterInfo(reg.id).size;
+    return true;
+  }
 
-    if (detail->cc == ARM64_CC_INVALID ||
-        (Rd_size != Rn_size && Rn_size != Rm_size)) {
+  bool ResolveRegister(const char* name, RegisterOperand& reg) {
+    if (!FindRegister(name, reg)) {
+      LogError("AArch64 architecture has no register %s", name);
       return false;
     }
+    return true;
+  }
 
-    // Never is actually _always_, Capstone internal
-    if (detail->cc == ARM64_CC_AL || detail->cc == ARM64_CC_NV) {
-      il.AddInstruction(il.SetRegister(Rd_size, il.Register(Rd_size, Rd),
-                                       il.Register(Rn_size, Rn)));
-      return true;
-    }
+  /**
+   * Resolve a general purpose register, register number 31 is the zero register
+   */
+  const RegisterOperand& Gpr(size_t size, uint8_t number) const {
+    return mGeneralRegisters[size == 8][number];
+  }
 
-    LowLevelILLabel assignmentLabel, incrementLabel, afterLabel;
+  /**
+   * Resolve a SIMD&FP register of 8 or 16 bytes, register numbers wrap around as in the register lists
+   */
+  const RegisterOperand& Vr(size_t size, unsigned int number) const {
+    return mVectorRegisters[size == 16][number % 32];
+  }
 
-    il.AddInstruction(il.If(il.FlagCondition(LiftCondition(detail->cc)),
-                            assignmentLabel, incrementLabel));
+  const RegisterOperand& Zr(unsigned int number) const {
+    return mScalableRegisters[number % 32];
+  }
 
-    // Rd = Rn
-    il.MarkLabel(assignmentLabel);
-    il.AddInstruction(il.SetRegister(Rd_size, Rd, il.Register(Rn_size, Rn)));
-    il.AddInstruction(il.Goto(afterLabel));
+  const RegisterOperand& Pr(unsigned int number) const {
+    return mPredicateRegisters[number % 16];
+  }
 
-    // Rd = Rm + 1
-    il.MarkLabel(incrementLabel);
-    il.AddInstruction(il.SetRegister(
-        Rd_size, Rd,
-        il.Add(Rd_size, il.Register(Rm_size, Rm), il.Const(Rd_size, 1))));
+  /**
+   * Base register of a load or store, register number 31 is the stack pointer
+   */
+  const RegisterOperand& BaseRegister(uint8_t number) const {
+    return number == 31 ? mStackPointers[1] : Gpr(8, number);
+  }
 
-    il.MarkLabel(afterLabel);
+  /**
+   * Operand of the peephole simplifier: a constant, a register read or a built expression. Constants and register
+   * reads are only emitted once the operation they feed is known not to fold away, so that folded operands leave no
+   * dead expressions behind
+   */
+  struct Value {
+    enum class Kind : uint8_t { Constant, Register, Expression };
+    Kind kind;
+    // Value of a constant, truncated to the size of the operation
+    uint64_t constant;
+    // Register to read, or the built expression
+    uint32_t reg;
+    ExprId expr;
+  };
 
-    return true;
+  static Value Constant(uint64_t constant) {
+    return {Value::Kind::Constant, constant, 0, 0};
   }
 
-  bool LiftUMULL(cs_insn* instr, LowLevelILFunction& il) {
-    cs_arm64* detail = &(instr->detail->arm64);
+  static Value Expression(ExprId expr) {
+    return {Value::Kind::Expression, 0, 0, expr};
+  }
 
-    if (detail->op_count != 3) {
-      return false;
+  /**
+   * Read a general purpose register, the zero register reads as the constant 0
+   */
+  Value ReadGpr(size_t size, uint8_t number) const {
+    if (number == 31) {
+      return Constant(0);
     }
 
-    uint32_t Xd = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[0].reg));
-    uint32_t Wn = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[1].reg));
-    uint32_t Wm = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[2].reg));
+    return {Value::Kind::Register, 0, Gpr(size, number).id, 0};
+  }
 
-    il.AddInstruction(il.SetRegister(
-        8, Xd, il.Mult(8, il.Register(4, Wn), il.Register(4, Wm))));
+  static bool IsConstant(const Value& value, uint64_t constant) {
+    return value.kind == Value::Kind::Constant && value.constant == constant;
+  }
 
-    return true;
+  static ExprId Emit(LowLevelILFunction& il, size_t size, const Value& value) {
+    switch (value.kind) {
+    case Value::Kind::Constant:
+      return il.Const(size, value.constant);
+    case Value::Kind::Register:
+      return il.Register(size, value.reg);
+    default:
+      return value.expr;
+    }
   }
 
-  bool LiftCINC(cs_insn* instr, LowLevelILFunction& il) {
-    cs_arm64* detail = &(instr->detail->arm64);
+  static Value FoldAnd(LowLevelILFunction& il, size_t size, const Value& a,
+                       const Value& b) {
+    uint64_t ones = Ones<uint64_t>(size * 8);
+    if (a.kind == Value::Kind::Constant && b.kind == Value::Kind::Constant) {
+      return Constant(a.constant & b.constant & ones);
+    } else if (IsConstant(a, 0) || IsConstant(b, ones)) {
+      return a;
+    } else if (IsConstant(b, 0) || IsConstant(a, ones)) {
+      return b;
+    }
 
-    if (detail->op_count != 2) {
-      return false;
+    return Expression(il.And(size, Emit(il, size, a), Emit(il, size, b)));
+  }
+
+  static Value FoldOr(LowLevelILFunction& il, size_t size, const Value& a,
+                      const Value& b) {
+    uint64_t ones = Ones<uint64_t>(size * 8);
+    if (a.kind == Value::Kind::Constant && b.kind == Value::Kind::Constant) {
+      return Constant((a.constant | b.constant) & ones);
+    } else if (IsConstant(a, 0) || IsConstant(b, ones)) {
+      return b;
+    } else if (IsConstant(b, 0) || IsConstant(a, ones)) {
+      return a;
     }
 
-    uint32_t Rd = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[0].reg));
-    uint32_t Rn = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[1].reg));
-    size_t Rd_size = this->m_base->GetRegisterInfo(Rd).size;
-    size_t Rn_size = this->m_base->GetRegisterInfo(Rn).size;
+    return Expression(il.Or(size, Emit(il, size, a), Emit(il, size, b)));
+  }
 
-    if (detail->cc == ARM64_CC_INVALID) {
-      return false;
+  static Value FoldAdd(LowLevelILFunction& il, size_t size, const Value& a,
+                       const Value& b) {
+    if (a.kind == Value::Kind::Constant && b.kind == Value::Kind::Constant) {
+      return Constant((a.constant + b.constant) & Ones<uint64_t>(size * 8));
+    } else if (IsConstant(a, 0)) {
+      return b;
+    } else if (IsConstant(b, 0)) {
+      return a;
     }
 
-    if (detail->cc == ARM64_CC_AL || detail->cc == ARM64_CC_NV) {
-      // Rd = Rn + 1
-      il.AddInstruction(il.SetRegister(
-          Rd_size, Rd,
-          il.Add(Rd_size, il.Register(Rn_size, Rn), il.Const(Rd_size, 1))));
-      return true;
+    return Expression(il.Add(size, Emit(il, size, a), Emit(il, size, b)));
+  }
+
+  static Value FoldSub(LowLevelILFunction& il, size_t size, const Value& a,
+                       const Value& b) {
+    if (a.kind == Value::Kind::Constant && b.kind == Value::Kind::Constant) {
+      return Constant((a.constant - b.constant) & Ones<uint64_t>(size * 8));
+    } else if (IsConstant(b, 0)) {
+      return a;
+    } else if (IsConstant(a, 0)) {
+      return FoldNeg(il, size, b);
     }
 
-    LowLevelILLabel incrementLabel, assignmentLabel, afterLabel;
+    return Expression(il.Sub(size, Emit(il, size, a), Emit(il, size, b)));
+  }
 
-    il.AddInstruction(il.If(il.FlagCondition(LiftCondition(detail->cc)),
-                            incrementLabel, assignmentLabel));
+  static Value FoldNot(LowLevelILFunction& il, size_t size, const Value& a) {
+    if (a.kind == Value::Kind::Constant) {
+      return Constant(~a.constant & Ones<uint64_t>(size * 8));
+    }
 
-    // Rd = Rn + 1
-    il.MarkLabel(incrementLabel);
-    il.AddInstruction(il.SetRegister(
-        Rd_size, Rd,
-        il.Add(Rd_size, il.Register(Rn_size, Rn), il.Const(Rd_size, 1))));
-    il.AddInstruction(il.Goto(afterLabel));
+    return Expression(il.Not(size, Emit(il, size, a)));
+  }
 
-    // Rd = Rn
-    il.MarkLabel(assignmentLabel);
-    il.AddInstruction(il.SetRegister(Rd_size, Rd, il.Register(Rn_size, Rn)));
+  static Value FoldNeg(LowLevelILFunction& il, size_t size, const Value& a) {
+    if (a.kind == Value::Kind::Constant) {
+      return Constant((0 - a.constant) & Ones<uint64_t>(size * 8));
+    }
 
-    il.MarkLabel(afterLabel);
+    return Expression(il.Neg(size, Emit(il, size, a)));
+  }
 
-    return true;
+  static Value FoldShiftLeft(LowLevelILFunction& il, size_t size,
+                             const Value& a, unsigned int shift) {
+    if (shift == 0) {
+      return a;
+    } else if (a.kind == Value::Kind::Constant) {
+      uint64_t shifted = shift < 64 ? a.constant << shift : 0;
+      return Constant(shifted & Ones<uint64_t>(size * 8));
+    }
+
+    return Expression(
+        il.ShiftLeft(size, Emit(il, size, a), il.Const(1, shift)));
   }
 
-  bool LiftBFI(cs_insn* instr, LowLevelILFunction& il) {
-    cs_arm64* detail = &(instr->detail->arm64);
+  static Value FoldLogicalShiftRight(LowLevelILFunction& il, size_t size,
+                                     const Value& a, unsigned int shift) {
+    if (shift == 0) {
+      return a;
+    } else if (a.kind == Value::Kind::Constant) {
+      return Constant(shift < 64 ? a.constant >> shift : 0);
+    }
+
+    return Expression(
+        il.LogicalShiftRight(size, Emit(il, size, a), il.Const(1, shift)));
+  }
 
-    if (detail->op_count != 4) {
-      return false;
+  static Value FoldArithShiftRight(LowLevelILFunction& il, size_t size,
+                                   const Value& a, unsigned int shift) {
+    // Only the zero register folds to a constant, and its arithmetic shift is 0 as well
+    if (shift == 0 || IsConstant(a, 0)) {
+      return a;
     }
 
-    uint32_t Rd = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[0].reg));
-    uint32_t Rn = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[1].reg));
-    size_t Rd_size = this->m_base->GetRegisterInfo(Rd).size;
-    size_t Rn_size = this->m_base->GetRegisterInfo(Rd).size;
-    int64_t lsb = detail->operands[2].imm;
-    int64_t width = detail->operands[3].imm;
+    return Expression(
+        il.ArithShiftRight(size, Emit(il, size, a), il.Const(1, shift)));
+  }
 
-    // Continue if the both are same size and either 32-bit or 64-bit
-    if (Rd_size != Rn_size && !(Rd_size == 4 ^ Rd_size == 8)) {
-      return false;
+  static Value FoldRotateRight(LowLevelILFunction& il, size_t size,
+                               const Value& a, const Value& shift) {
+    unsigned int bits = size * 8;
+    uint64_t ones = Ones<uint64_t>(bits);
+    // Rotating all zeros or all ones is a no-op, whatever the amount
+    if (IsConstant(a, 0) || IsConstant(a, ones)) {
+      return a;
+    } else if (shift.kind == Value::Kind::Constant) {
+      unsigned int amount = shift.constant % bits;
+      if (amount == 0) {
+        return a;
+      } else if (a.kind == Value::Kind::Constant) {
+        return Constant((a.constant >> amount | a.constant << (bits - amount)) &
+                        ones);
+      }
     }
 
-    uint64_t inclusion_mask;
-    if (Rd_size == 8) {
-      inclusion_mask = Ones<uint64_t>(width) << lsb;
-    } else {
-      inclusion_mask = Ones<uint32_t>(width) << lsb;
+    return Expression(
+        il.RotateRight(size, Emit(il, size, a), Emit(il, size, shift)));
+  }
+
+  /**
+   * Write a general purpose register, writes to the zero register are discarded. Sources that folded to a register
+   * copy or a constant are emitted as such
+   */
+  void SetGpr(LowLevelILFunction& il, size_t size, uint8_t number,
+              const Value& value) {
+    if (number == 31) {
+      il.AddInstruction(il.Nop());
+      return;
     }
 
-    ExprId left = il.And(Rd_size, il.Register(Rd_size, Rd),
-                         il.Const(Rd_size, ~inclusion_mask));
-    ExprId right = il.And(
-        Rd_size,
-        il.ShiftLeft(Rd_size, il.Register(Rd_size, Rn), il.Const(1, lsb)),
-        il.Const(Rd_size, inclusion_mask));
-    il.AddInstruction(il.SetRegister(Rd_size, Rd, il.Or(Rd_size, left, right)));
+    il.AddInstruction(
+        il.SetRegister(size, Gpr(size, number).id, Emit(il, size, value)));
+  }
 
-    return true;
+  /**
+   * Convert a condition code to BNIL condition code
+   *
+   * @param condition AArch64 condition code, other than AL and NV
+   * @return BNIL condition, or -1
+   */
+  static BNLowLevelILFlagCondition LiftCondition(aarch64::Condition condition) {
+    switch (condition) {
+    case aarch64::Condition::EQ:
+      return LLFC_E;
+    case aarch64::Condition::NE:
+      return LLFC_NE;
+    case aarch64::Condition::HS:
+      return LLFC_UGE;
+    case aarch64::Condition::LO:
+      return LLFC_ULT;
+    case aarch64::Condition::MI:
+      return LLFC_NEG;
+    case aarch64::Condition::PL:
+      return LLFC_POS;
+    case aarch64::Condition::VS:
+      return LLFC_O;
+    case aarch64::Condition::VC:
+      return LLFC_NO;
+    case aarch64::Condition::HI:
+      return LLFC_UGT;
+    case aarch64::Condition::LS:
+      return LLFC_ULE;
+    case aarch64::Condition::GE:
+      return LLFC_SGE;
+    case aarch64::Condition::LT:
+      return LLFC_SLT;
+    case aarch64::Condition::GT:
+      return LLFC_SGT;
+    case aarch64::Condition::LE:
+      return LLFC_SLE;
+    default:
+      return (BNLowLevelILFlagCondition) -1;
+    }
   }
 
-  bool LiftROR(cs_insn* instr, LowLevelILFunction& il) {
-    cs_arm64* detail = &(instr->detail->arm64);
+  /**
+   * Rn of a comparison, register number 31 is the stack pointer in the immediate form and the zero register otherwise
+   */
+  ExprId ComparisonRegister(
+      LowLevelILFunction& il,
+      const aarch64::SequenceTracker::Comparison& comparison) const {
+    size_t size = comparison.size;
+    if (comparison.hasImmediate) {
+      const RegisterOperand& Rn = GprOrSp(size, comparison.rn);
+      return il.Register(Rn.size, Rn.id);
+    }
 
-    if (detail->op_count != 3) {
-      return false;
+    return Emit(il, size, ReadGpr(size, comparison.rn));
+  }
+
+  /**
+   * Operand subtracted from Rn by a comparison
+   */
+  ExprId ComparisonOperand(
+      LowLevelILFunction& il,
+      const aarch64::SequenceTracker::Comparison& comparison) const {
+    size_t size = comparison.size;
+    if (comparison.hasImmediate) {
+      return il.Const(size, comparison.imm);
     }
 
-    uint32_t Rd = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[0].reg));
-    uint32_t Rn = this->m_base->GetRegisterByName(
-        cs_reg_name(disassembler.Get(), detail->operands[1].reg));
+    ExprId Rm = Emit(il, size, ReadGpr(size, comparison.rm));
+    if (comparison.shift == 0) {
+      return Rm;
+    }
+    return il.ShiftLeft(size, Rm, il.Const(1, comparison.shift));
+  }
 
-    size_t Rd_size = this->m_base->GetRegisterInfo(Rd).size;
-    size_t Rn_size = this->m_base->GetRegisterInfo(Rd).size;
+  /**
+   * Returns true for the conditions that hold a relation of the operands of a comparison. MI and PL test the sign of
+   * the difference and VS and VC its overflow
+   */
+  static bool IsRelation(aarch64::Condition condition) {
+    return condition != aarch64::Condition::MI &&
+           condition != aarch64::Condition::PL &&
+           condition != aarch64::Condition::VS &&
+           condition != aarch64::Condition::VC;
+  }
 
-    if (Rd_size != Rn_size) {
-      return false;
+  /**
+   * Build a condition. Right after a comparison the extension lifted, the conditions that hold a relation of its
+   * operands compare them directly, so that the consumer does not read the flags and the core can drop their writes
+   *
+   * @param condition AArch64 condition code, other than AL and NV
+   */
+  ExprId ConditionExpression(LowLevelILFunction& il,
+                             aarch64::Condition condition) {
+    aarch64::SequenceTracker::Comparison comparison;
+    if (!IsRelation(condition) ||
+        !GetThreadState().sequence.GetComparison(comparison)) {
+      return il.FlagCondition(LiftCondition(condition));
     }
 
-    if (detail->operands[2].type == ARM64_OP_REG) {
-      uint32_t Rm = this->m_base->GetRegisterByName(
-          cs_reg_name(disassembler.Get(), detail->operands[2].reg));
+    size_t size = comparison.size;
+    ExprId left = ComparisonRegister(il, comparison);
+    ExprId right = ComparisonOperand(il, comparison);
+    switch (condition) {
+    case aarch64::Condition::EQ:
+      return il.CompareEqual(size, left, right);
+    case aarch64::Condition::NE:
+      return il.CompareNotEqual(size, left, right);
+    case aarch64::Condition::HS:
+      return il.CompareUnsignedGreaterEqual(size, left, right);
+    case aarch64::Condition::LO:
+      return il.CompareUnsignedLessThan(size, left, right);
+    case aarch64::Condition::HI:
+      return il.CompareUnsignedGreaterThan(size, left, right);
+    case aarch64::Condition::LS:
+      return il.CompareUnsignedLessEqual(size, left, right);
+    case aarch64::Condition::GE:
+      return il.CompareSignedGreaterEqual(size, left, right);
+    case aarch64::Condition::LT:
+      return il.CompareSignedLessThan(size, left, right);
+    case aarch64::Condition::GT:
+      return il.CompareSignedGreaterThan(size, left, right);
+    default:
+      return il.CompareSignedLessEqual(size, left, right);
+    }
+  }
 
-      il.AddInstruction(
-          il.SetRegister(Rd_size, Rd,
-                         il.RotateRight(Rd_size, il.Register(Rd_size, Rn),
-                                        il.Register(Rd_size, Rm))));
-      return true;
-    } else if (detail->operands[2].type == ARM64_OP_IMM) {
-      uint32_t shift = detail->operands[2].imm;
+  /**
+   * Set Rd to one of two values depending on a condition
+   *
+   * By default this is lifted as an If with a block for each value. In flat mode it is lifted as a single branchless
+   * assignment, Rd = (trueValue & -cond) | (falseValue & (cond - 1)), so that the instruction does not split the basic
+   * block it is in
+   *
+   * @param trueValue, falseValue callables building the simplifier value of each value, each is called at most once
+   */
+  template <typename TrueValue, typename FalseValue>
+  void LiftConditionalSelect(LowLevelILFunction& il, size_t size, uint8_t rd,
+                             aarch64::Condition cond, TrueValue trueValue,
+                             FalseValue falseValue) {
+    // A select into the zero register has no effect at all
+    if (rd == 31) {
+      il.AddInstruction(il.Nop());
+      return;
+    }
 
-      il.AddInstruction(
-          il.SetRegister(Rd_size, Rd,
-                         il.RotateRight(Rd_size, il.Register(Rd_size, Rn),
-                                        il.Const(Rd_size, shift))));
-      return true;
+    // Never is actually _always_
+    if (cond == aarch64::Condition::AL || cond == aarch64::Condition::NV) {
+      SetGpr(il, size, rd, trueValue());
+      return;
     }
 
-    return false;
-  }
+    if (mFlatConditionalSelect) {
+      // The mask of a value that folded to 0 is not built at all
+      Value selected = Constant(0);
+      Value value = trueValue();
+      if (!IsConstant(value, 0)) {
+        ExprId trueMask =
+            il.Neg(size, il.BoolToInt(size, ConditionExpression(il, cond)));
+        selected = FoldAnd(il, size, value, Expression(trueMask));
+      }
 
-  bool GetInstructionLowLevelIL(const uint8_t* data, uint64_t addr, size_t& len,
-                                LowLevelILFunction& il) override {
-    cs_insn* instr;
-    size_t count = cs_disasm(disassembler.Get(), data, len, addr, 0, &instr);
-
-    bool supported = false;
-    if (count > 0) {
-      switch (instr->id) {
-      case ARM64_INS_CSINC:
-#ifdef AARCH64_TRACE_INSTR
-        LogInfo("CSINC @ 0x%lx", instr->address);
-#endif
-        supported = LiftCSINC(instr, il);
-        break;
-      case ARM64_INS_UMULL:
-#ifdef AARCH64_TRACE_INSTR
-        LogInfo("UMULL @ 0x%lx", instr->address);
-#endif
-        supported = LiftUMULL(instr, il);
-        break;
-      case ARM64_INS_CINC:
-#ifdef AARCH64_TRACE_INSTR
-        LogInfo("CINC @ 0x%lx", instr->address);
-#endif
-        supported = LiftCINC(instr, il);
-        break;
-      case ARM64_INS_BFI:
-#ifdef AARCH64_TRACE_INSTR
-        LogInfo("BFI @ 0x%lx", instr->address);
-#endif
-        supported = LiftBFI(instr, il);
-        break;
-      case ARM64_INS_ROR:
-#ifdef AARCH64_TRACE_INSTR
-        LogInfo("ROR @ 0x%lx", instr->address);
-#endif
-        supported = LiftROR(instr, il);
-        break;
+      value = falseValue();
+      if (!IsConstant(value, 0)) {
+        ExprId falseMask =
+            il.Sub(size, il.BoolToInt(size, ConditionExpression(il, cond)),
+                   il.Const(size, 1));
+        selected = FoldOr(il, size, selected,
+                          FoldAnd(il, size, value, Expression(falseMask)));
       }
+
+      SetGpr(il, size, rd, selected);
+      return;
     }
 
-    len = instr->size;
-    if (count > 0) {
-      cs_free(instr, count);
+    LowLevelILLabel trueLabel, falseLabel, afterLabel;
+
+    il.AddInstruction(
+        il.If(ConditionExpression(il, cond), trueLabel, falseLabel));
+
+    il.MarkLabel(trueLabel);
+    SetGpr(il, size, rd, trueValue());
+    il.AddInstruction(il.Goto(afterLabel));
+
+    il.MarkLabel(falseLabel);
+    SetGpr(il, size, rd, falseValue());
+
+    il.MarkLabel(afterLabel);
+  }
+
+  /**
+   * Write a whole Q register, values of the 64-bit forms are zero-extended as the instructions clear the upper half
+   */
+  void SetVectorRegister(LowLevelILFunction& il, size_t size,
+                         unsigned int number, ExprId value) {
+    if (size != 16) {
+      value = il.ZeroExtend(16, value);
     }
+    il.AddInstruction(il.SetRegister(16, Vr(16, number).id, value));
+  }
+
+  ExprId VectorRegister(LowLevelILFunction& il, size_t size,
+                        unsigned int number) {
+    return il.Register(size, Vr(size, number).id);
+  }
 
-    if (!supported) {
-      return ArchitectureHook::GetInstructionLowLevelIL(data, addr, len, il);
+  /**
+   * Build a vector constant of 8 or 16 bytes, holding pattern in every 64-bit half
+   */
+  static ExprId VectorConstant(LowLevelILFunction& il, size_t size,
+                               uint64_t pattern) {
+    if (size != 16) {
+      return il.Const(size, pattern);
+    } else if (pattern == 0) {
+      return il.Const(16, 0);
+    } else if (pattern == ~static_cast<uint64_t>(0)) {
+      return il.Not(16, il.Const(16, 0));
     }
 
-    return true;
+    return il.Or(16,
+                 il.ShiftLeft(16, il.ZeroExtend(16, il.Const(8, pattern)),
+                              il.Const(1, 64)),
+                 il.ZeroExtend(16, il.Const(8, pattern)));
   }
-};
 
-extern "C" {
-BINARYNINJAPLUGIN void CorePluginDependencies() {
-  AddRequiredPluginDependency("arch_arm64");
-}
+  /**
+   * Build a vector of 8 or 16 bytes with an element repeated in every lane, by multiplying it with a pattern of ones
+   * rather than assembling the lanes one by one
+   *
+   * @param element callable building the esize bytes expression of the element, called once per 64-bit half
+   */
+  template <typename Element>
+  static ExprId Broadcast(LowLevelILFunction& il, size_t size, size_t esize,
+                          Element element) {
+    auto half = [&] {
+      if (esize == 8) {
+        return element();
+      }
+      return il.Mult(8, il.ZeroExtend(8, element()),
+                     il.Const(8, aarch64::Replicate(1, esize * 8)));
+    };
 
-BINARYNINJAPLUGIN bool CorePluginInit() {
-  if (!disassembler.IsOK()) {
-    LogError("Failed to create AArch64 disassembler engine");
-    return false;
+    if (size != 16) {
+      return half();
+    }
+
+    return il.Or(16,
+                 il.ShiftLeft(16, il.ZeroExtend(16, half()), il.Const(1, 64)),
+                 il.ZeroExtend(16, half()));
   }
 
-  Architecture* aarch64Ext =
-      new AArch64ArchitectureExtension(Architecture::GetByName("aarch64"));
-  Architecture::Register(aarch64Ext);
+  /**
+   * Emit an intrinsic of the extension writing a single register
+   */
+  static void AddIntrinsic(LowLevelILFunction& il, uint32_t output,
+                           aarch64::Intrinsic intrinsic,
+                           const std::vector<ExprId>& params) {
+    il.AddInstruction(il.Intrinsic(
+        {RegisterOrFlag::Register(output)},
+        kIntrinsicBase + static_cast<uint32_t>(intrinsic), params));
+  }
 
-  LogInfo("Registered AArch64 extensions plugin");
+#ifdef AARCH64_CAPSTONE_CROSSCHECK
+  /**
+   * Verify the native decoding of an instruction against Capstone, disagreements are logged
+   */
+  void CrossCheck(const uint8_t* data, uint64_t addr,
+                  const aarch64::Instruction& instr) {
+    Disassembler& disassembler = GetThreadState().disassembler;
+    cs_insn* reference = disassembler.Disassemble(data, 4, addr);
+    if (reference == nullptr) {
+      LogWarn("Decoded %s @ 0x%" PRIx64 ", Capstone rejects it",
+              aarch64::GetOpcodeName(instr.opcode), addr);
+      return;
+    }
 
-  return true;
+    // Capstone prints MOVZ, MOVN and ADD to or from the stack pointer as MOV when that is the preferred alias, and
+    // SUB from the zero register as NEG
+    bool moveAlias = (reference->id == ARM64_INS_MOV &&
+                      (instr.opcode == aarch64::Opcode::MOVZ ||
+                       instr.opcode == aarch64::Opcode::MOVN ||
+                       instr.opcode == aarch64::Opcode::ADD)) ||
+                     (reference->id == ARM64_INS_NEG &&
+                      instr.opcode == aarch64::Opcode::SUB);
+    // The ids of the atomics also encode the ordering and the size, e.g. LDADDAL or CASB, and the ST* aliases, those
+    // of the pointer authentication instructions the modifier, e.g. PACIASP or BRAAZ
+    bool atomic = aarch64::IsAtomicOpcode(instr.opcode);
+    bool pointerAuth = aarch64::IsPointerAuthOpcode(instr.opcode);
+    if (reference->id != GetCapstoneId(instr.opcode) && !moveAlias &&
+        !atomic && !pointerAuth) {
+      // A diet Capstone has no instruction names
+      const char* name = cs_insn_name(disassembler.Get(), reference->id);
+      LogWarn("Decoded %s @ 0x%" PRIx64 ", Capstone decodes %s (id %u)",
+              aarch64::GetOpcodeName(instr.opcode), addr,
+              name != nullptr ? name : "?", reference->id);
+      return;
+    }
+
+    // Vector register names do not map to the general purpose register table
+    if (aarch64::IsVectorOpcode(instr.opcode) ||
+        aarch64::IsScalableOpcode(instr.opcode)) {
+      return;
+    }
+
+    // The first operand of CAS is Rs, and that of the ST* aliases of the atomics is not a destination. The hint forms
+    // of pointer authentication have no operands, and the branches and the comparisons other than SUBS no destination
+    if (atomic || pointerAuth || instr.opcode == aarch64::Opcode::BR ||
+        (aarch64::IsComparisonOpcode(instr.opcode) &&
+         instr.opcode != aarch64::Opcode::SUBS)) {
+      return;
+    }
+
+    const cs_arm64* detail = &(reference->detail->arm64);
+    if (detail->op_count > 0 && detail->operands[0].type == ARM64_OP_REG &&
+        detail->operands[0].reg !=
+            GetCapstoneRegister(instr.size, instr.rd,
+                                instr.opcode == aarch64::Opcode::ADD &&
+                                    instr.hasImmediate)) {
+      LogWarn("Decoded %s @ 0x%" PRIx64 " with a destination other than "
+              "Capstone register %u",
+              aarch64::GetOpcodeName(instr.opcode), addr,
+              static_cast<unsigned int>(detail->operands[0].reg));
+    }
+  }
+#endif
+
+  /**
+   * Resolve the registers and load the settings of the lifters, once, on the first call that needs them. Until then the
+   * extension is only a registered hook. If the base architecture lacks any of the registers no lifter is enabled, and
+   * every instruction is left to it
+   */
+  void EnsureInitialized() {
+    if (mInitialized.load(std::memory_order_acquire)) {
+      return;
+    }
+
+    std::call_once(mInitializeOnce, [this]() {
+      if (BuildRegisterTable()) {
+        LoadSettings();
+      } else {
+        LogError("Failed to resolve AArch64 registers, AArch64 extensions "
+                 "are disabled");
+      }
+      mInitialized.store(true, std::memory_order_release);
+    });
+  }
+
+public:
+  explicit AArch64ArchitectureExtension(Architecture* aarch64)
+      : ArchitectureHook(aarch64) {
+  }
+
+  /**
+   * Register the settings of the extension, must be called once before LoadSettings
+   */
+  static void RegisterSettings() {
+    Ref<Settings> settings = Settings::Instance();
+    settings->RegisterGroup("aarch64ext", "AArch64 Extensions");
+    settings->RegisterSetting("aarch64ext.lift.flatConditionalSelect",
+                              R"~({
+          "title" : "Branchless Conditional Selects",
+          "type" : "boolean",
+          "default" : false,
+          "description" : "Lift the conditional select family (CSEL, CSINC, CSINV, CSNEG and their aliases) as straight-line arithmetic instead of a block per outcome, so that they do not split basic blocks. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.lift.pointerAuthNop", R"~({
+          "title" : "Pointer Authentication as No-ops",
+          "type" : "boolean",
+          "default" : false,
+          "description" : "Lift the pointer signing, authentication and stripping instructions (PACIA, AUTIA, XPACI, their key variants and hint forms such as PACIASP) as no-ops that leave the pointer unchanged, instead of intrinsics. The authenticated branches (RETAA, BRAA, BLRAA and their variants) are lifted as plain returns, branches and calls either way. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.lift.elideFlagWrites", R"~({
+          "title" : "Elide Comparison Flags",
+          "type" : "boolean",
+          "default" : true,
+          "description" : "Lift a CMP or SUBS without setting the flags when the instruction right after it is a conditional select that reads them, and the one after that is another comparison that overwrites them, neither being a branch target. The conditional select compares the operands directly either way. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.stats.timing", R"~({
+          "title" : "Lifter Timing",
+          "type" : "boolean",
+          "default" : false,
+          "description" : "Count the cycles spent in each lifter, reported along with the lift statistics. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.stats.dumpOnExit", R"~({
+          "title" : "Dump Lift Statistics on Exit",
+          "type" : "boolean",
+          "default" : false,
+          "description" : "Print the lift statistics to stderr when Binary Ninja exits. Read when the plugin is loaded, changes take effect after a restart."
+        })~");
+    settings->RegisterSetting("aarch64ext.trace.sampleInterval", R"~({
+          "title" : "Lift Trace Sample Interval",
+          "type" : "number",
+          "default" : 0,
+          "minValue" : 0,
+          "maxValue" : 1000000,
+          "description" : "Record the address, mnemonic, duration and outcome of one in this many lift calls of each analysis thread, in a ring buffer of the last 16384 events per thread, exported with the Export lift trace command. 0 disables tracing. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.decode.prefetchDepth", R"~({
+          "title" : "Decode Prefetch Depth",
+          "type" : "number",
+          "default" : 16,
+          "minValue" : 0,
+          "maxValue" : 256,
+          "description" : "Number of instructions decoded into the decode cache past a miss, read from the view up to the next branch, so that the calls for the following addresses hit. 0 disables decoding ahead. Read on first use of the AArch64 architecture."
+        })~");
+    settings->RegisterSetting("aarch64ext.decode.persist", R"~({
+          "title" : "Persist Decoded Instructions",
+          "type" : "boolean",
+          "default" : false,
+          "description" : "Store the decoded instructions of every function in the database metadata once the initial analysis completes, and reuse them when the database is reopened instead of decoding again. Records are keyed by address and instruction word, patched bytes are decoded again. Read when the plugin is loaded, changes take effect after a restart."
+        })~");
+    settings->RegisterSetting("aarch64ext.decode.prescan", R"~({
+          "title" : "Prescan Executable Segments",
+          "type" : "boolean",
+          "default" : true,
+          "description" : "Scan the executable segments of every AArch64 view once it is opened for the instructions the lifters handle, so that lifting the others goes straight to the stock AArch64 lifter without decoding them. Patched pages are scanned again. Read when the plugin is loaded, changes take effect after a restart."
+        })~");
+    settings->RegisterSetting("aarch64ext.lift.disabled", R"~({
+          "title" : "Disabled Lifters",
+          "type" : "array",
+          "elementType" : "string",
+          "default" : [],
+          "description" : "Mnemonics left to the stock AArch64 lifter, e.g. csel or bfi. Aliases are named separately: disabling csinc does not disable cinc or cset. Read on first use of the AArch64 architecture."
+        })~");
+  }
+
+  void LoadSettings() {
+    Ref<Settings> settings = Settings::Instance();
+    mFlatConditionalSelect =
+        settings->Get<bool>("aarch64ext.lift.flatConditionalSelect");
+    mTimeLifters = settings->Get<bool>("aarch64ext.stats.timing");
+    mPointerAuthNop = settings->Get<bool>("aarch64ext.lift.pointerAuthNop");
+    mElideFlagWrites = settings->Get<bool>("aarch64ext.lift.elideFlagWrites");
+    // The entries decoded ahead must not evict the entry of the miss itself
+    mPrefetchDepth = std::min<size_t>(
+        settings->Get<uint64_t>("aarch64ext.decode.prefetchDepth"),
+        aarch64::DecodeCache::kEntries - 1);
+    mPersistDecodes = settings->Get<bool>("aarch64ext.decode.persist");
+    mPrescan = settings->Get<bool>("aarch64ext.decode.prescan");
+    mTraceInterval = static_cast<uint32_t>(
+        settings->Get<uint64_t>("aarch64ext.trace.sampleInterval"));
+
+    std::vector<std::string> disabled =
+        settings->Get<std::vector<std::string>>("aarch64ext.lift.disabled");
+
+    bool decoded[aarch64::kOpcodeCount] = {};
+    size_t count;
+    const LifterRegistration* registry = GetLifterRegistry(count);
+    for (size_t i = 0; i < count; i++) {
+      const LifterRegistration& lifter = registry[i];
+      if ((aarch64::IsScalableOpcode(lifter.opcode) && !mScalable) ||
+          (aarch64::IsComparisonOpcode(lifter.opcode) && !mComparisons)) {
+        continue;
+      }
+
+      if (std::find(disabled.begin(), disabled.end(),
+                    aarch64::GetOpcodeName(lifter.opcode)) != disabled.end()) {
+        LogInfo("AArch64 %s lifter disabled",
+                aarch64::GetOpcodeName(lifter.opcode));
+        continue;
+      }
+
+      mLifters[0][static_cast<size_t>(lifter.opcode)] = lifter.lift;
+      mLifters[1][static_cast<size_t>(lifter.opcode)] =
+          lifter.lift64 != nullptr ? lifter.lift64 : lifter.lift;
+      decoded[static_cast<size_t>(lifter.encoding)] = true;
+    }
+
+    mEncodingClassCount = 0;
+    for (const aarch64::EncodingClass& encoding : aarch64::kEncodingClasses) {
+      if (decoded[static_cast<size_t>(encoding.opcode)]) {
+        mEncodingClasses[mEncodingClassCount++] = encoding;
+      }
+    }
+  }
+
+  /**
+   * Resolve the Binary Ninja registers used by the lifters, must be called once before LoadSettings
+   *
+   * @return false if the base architecture lacks any of them
+   */
+  bool BuildRegisterTable() {
+    char name[8];
+    for (unsigned int number = 0; number < 31; number++) {
+      snprintf(name, sizeof(name), "w%u", number);
+      if (!ResolveRegister(name, mGeneralRegisters[0][number])) {
+        return false;
+      }
+
+      snprintf(name, sizeof(name), "x%u", number);
+      if (!ResolveRegister(name, mGeneralRegisters[1][number])) {
+        return false;
+      }
+    }
+
+    for (unsigned int number = 0; number < 32; number++) {
+      snprintf(name, sizeof(name), "d%u", number);
+      if (!ResolveRegister(name, mVectorRegisters[0][number])) {
+        return false;
+      }
+
+      snprintf(name, sizeof(name), "q%u", number);
+      if (!ResolveRegister(name, mVectorRegisters[1][number])) {
+        return false;
+      }
+    }
+
+    if (!ResolveRegister("wzr", mGeneralRegisters[0][31]) ||
+        !ResolveRegister("xzr", mGeneralRegisters[1][31]) ||
+        !ResolveRegister("wsp", mStackPointers[0]) ||
+        !ResolveRegister("sp", mStackPointers[1])) {
+      return false;
+    }
+
+    mConditionFlags = BuildFlagTable();
+    mComparisons = mConditionFlags && FindFlagWriteType("*", mFlagWriteAll);
+    if (!mComparisons) {
+      LogInfo("AArch64 architecture has no NZCV flags or no flag write type "
+              "setting them all, comparisons are left to it");
+    }
+
+    mScalable = mConditionFlags && BuildScalableRegisterTable();
+    if (!mScalable) {
+      LogInfo("AArch64 architecture has no SVE registers, SVE instructions "
+              "are left to it");
+    }
+    return true;
+  }
+
+  /**
+   * Resolve the NZCV flags
+   *
+   * @return false if any of them is missing
+   */
+  bool BuildFlagTable() {
+    unsigned int found = 0;
+    for (uint32_t flag : this->m_base->GetAllFlags()) {
+      std::string flagName = this->m_base->GetFlagName(flag);
+      uint32_t* id = flagName == "n"   ? &mNegativeFlag
+                     : flagName == "z" ? &mZeroFlag
+                     : flagName == "c" ? &mCarryFlag
+                     : flagName == "v" ? &mOverflowFlag
+                                       : nullptr;
+      if (id != nullptr) {
+        *id = flag;
+        found++;
+      }
+    }
+    return found == 4;
+  }
+
+  bool FindFlagWriteType(const char* name, uint32_t& type) {
+    for (uint32_t candidate : this->m_base->GetAllFlagWriteTypes()) {
+      if (this->m_base->GetFlagWriteTypeName(candidate) == name) {
+        type = candidate;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /**
+   * Resolve the Z and P registers, which older versions of the base architecture lack
+   *
+   * @return false if any of them is missing
+   */
+  bool BuildScalableRegisterTable() {
+    char name[8];
+    for (unsigned int number = 0; number < 32; number++) {
+      snprintf(name, sizeof(name), "z%u", number);
+      if (!FindRegister(name, mScalableRegisters[number])) {
+        return false;
+      }
+    }
+
+    for (unsigned int number = 0; number < 16; number++) {
+      snprintf(name, sizeof(name), "p%u", number);
+      if (!FindRegister(name, mPredicateRegisters[number])) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // AArch64 instructions are always little-endian, regardless of the data endianness
+  static uint32_t ReadWord(const uint8_t* data) {
+    return static_cast<uint32_t>(data[0]) |
+           static_cast<uint32_t>(data[1]) << 8 |
+           static_cast<uint32_t>(data[2]) << 16 |
+           static_cast<uint32_t>(data[3]) << 24;
+  }
+
+  /**
+   * Load the decode store of a database being opened, registered as a view finalization event
+   */
+  static void LoadDecodeStore(BinaryView* view) {
+    Ref<Metadata> metadata = view->QueryMetadata(kDecodeStoreKey);
+    if (!metadata || !metadata->IsRaw()) {
+      return;
+    }
+
+    std::shared_ptr<aarch64::DecodeStore> store =
+        std::make_shared<aarch64::DecodeStore>();
+    if (!store->Deserialize(metadata->GetRaw())) {
+      LogInfo("Ignoring the decoded AArch64 instructions stored by another "
+              "version of the plugin");
+      return;
+    }
+
+    LogInfo("Loaded %zu decoded AArch64 instructions from the database",
+            store->GetCount());
+    aarch64::DecodeStoreRegistry::Get().Set(view->GetObject(),
+                                            std::move(store));
+  }
+
+  /**
+   * Digest of the start addresses of a set of functions
+   */
+  static uint64_t GetCoverage(const std::vector<Ref<Function>>& functions) {
+    std::vector<uint64_t> starts;
+    starts.reserve(functions.size());
+    for (const Ref<Function>& function : functions) {
+      starts.push_back(function->GetStart());
+    }
+    std::sort(starts.begin(), starts.end());
+
+    // FNV-1a over the addresses
+    uint64_t digest = 0xCBF29CE484222325ull;
+    for (uint64_t start : starts) {
+      for (size_t i = 0; i < 8; i++) {
+        digest = (digest ^ (start >> (i * 8) & 0xFF)) * 0x100000001B3ull;
+      }
+    }
+    return digest;
+  }
+
+  /**
+   * Decode every instruction of the AArch64 functions of a view into its metadata, which is saved along with the
+   * database. Registered as an initial analysis completion event, it does nothing when the store loaded from the
+   * database was decoded from the same functions
+   */
+  static void SaveDecodeStore(BinaryView* view) {
+    std::vector<Ref<Function>> functions;
+    for (const Ref<Function>& function : view->GetAnalysisFunctionList()) {
+      Ref<Architecture> arch = function->GetArchitecture();
+      if (arch && arch->GetName() == "aarch64") {
+        functions.push_back(function);
+      }
+    }
+
+    aarch64::DecodeStoreRegistry& registry =
+        aarch64::DecodeStoreRegistry::Get();
+    uint64_t coverage = GetCoverage(functions);
+    std::shared_ptr<const aarch64::DecodeStore> loaded =
+        registry.Find(view->GetObject());
+    if (loaded && loaded->GetCoverage() == coverage) {
+      return;
+    }
+
+    std::vector<aarch64::DecodeStore::Record> records;
+    std::vector<uint8_t> bytes;
+    for (const Ref<Function>& function : functions) {
+      for (const Ref<BasicBlock>& block : function->GetBasicBlocks()) {
+        uint64_t start = block->GetStart();
+        bytes.resize(block->GetEnd() - start);
+        size_t length = view->Read(bytes.data(), start, bytes.size());
+        for (size_t offset = 0; offset + 4 <= length; offset += 4) {
+          aarch64::DecodeStore::Record record;
+          record.addr = start + offset;
+          record.word = ReadWord(bytes.data() + offset);
+          if (aarch64::Decode(record.word, record.instr)) {
+            records.push_back(record);
+          }
+        }
+      }
+    }
+
+    std::shared_ptr<aarch64::DecodeStore> store =
+        std::make_shared<aarch64::DecodeStore>();
+    store->Reserve(records.size());
+    for (const aarch64::DecodeStore::Record& record : records) {
+      store->Add(record.addr, record.word, record.instr);
+    }
+    store->SetCoverage(coverage);
+
+    // Auto metadata, so that storing it does not mark the database as modified by the user
+    view->StoreMetadata(kDecodeStoreKey, new Metadata(store->Serialize()),
+                        true);
+    registry.Set(view->GetObject(), std::move(store));
+  }
+
+  /**
+   * Look an instruction up in the decode stores loaded from the databases
+   *
+   * @return stored instruction, or nullptr if no store holds this word at addr
+   */
+  static const aarch64::Instruction* FindStored(uint64_t addr, uint32_t word) {
+    ThreadState& state = GetThreadState();
+    aarch64::DecodeStoreRegistry& registry =
+        aarch64::DecodeStoreRegistry::Get();
+    uint64_t generation = registry.GetGeneration();
+    if (generation != state.storeGeneration) {
+      state.store = registry.GetMerged();
+      state.storeGeneration = generation;
+    }
+
+    return state.store ? state.store->Find(addr, word) : nullptr;
+  }
+
+  /**
+   * Rescans the pages of a view patched after its prescan. Insertions and removals move the bytes under the ranges,
+   * the bitmap is dropped then
+   */
+  class PrescanNotification : public BinaryDataNotification {
+  private:
+    AArch64ArchitectureExtension* mExtension;
+
+  public:
+    explicit PrescanNotification(AArch64ArchitectureExtension* extension)
+        : mExtension(extension) {
+    }
+
+    void OnBinaryDataWritten(BinaryView* view, uint64_t offset,
+                             size_t len) override {
+      mExtension->RescanPages(view, offset, len);
+    }
+
+    void OnBinaryDataInserted(BinaryView* view, uint64_t, size_t) override {
+      aarch64::PrescanRegistry::Get().Set(view->GetObject(), nullptr);
+    }
+
+    void OnBinaryDataRemoved(BinaryView* view, uint64_t, uint64_t) override {
+      aarch64::PrescanRegistry::Get().Set(view->GetObject(), nullptr);
+    }
+  };
+
+  /**
+   * Read the bytes of a prescan chunk and scan them against the enabled encoding classes
+   */
+  void ScanChunk(BinaryView* view, aarch64::PrescanBitmap& bitmap,
+                 const aarch64::PrescanBitmap::Chunk& chunk,
+                 std::vector<uint8_t>& bytes, std::vector<uint64_t>& scratch) {
+    bytes.resize(chunk.slots * 4);
+    size_t length = view->Read(bytes.data(), chunk.addr, bytes.size());
+    bitmap.Scan(chunk, bytes.data(), length, mEncodingClasses,
+                mEncodingClassCount, scratch);
+  }
+
+  /**
+   * Scan the executable segments of an AArch64 view being opened on a worker thread. Registered as a view finalization
+   * event
+   */
+  void PrescanView(BinaryView* view) {
+    Ref<Architecture> arch = view->GetDefaultArchitecture();
+    if (!arch || arch->GetName() != "aarch64") {
+      return;
+    }
+
+    EnsureInitialized();
+    if (mEncodingClassCount == 0) {
+      return;
+    }
+
+    std::shared_ptr<aarch64::PrescanBitmap> bitmap =
+        std::make_shared<aarch64::PrescanBitmap>();
+    for (const Ref<Segment>& segment : view->GetSegments()) {
+      if (segment->GetFlags() & SegmentExecutable) {
+        bitmap->AddRange(segment->GetStart(), segment->GetEnd());
+      }
+    }
+
+    if (bitmap->IsEmpty()) {
+      return;
+    }
+
+    // Every bit is set until its chunk is scanned, so the bitmap is registered right away and the scan runs in the
+    // background rather than holding up the view being opened. A page patched while the scan reads it may be left
+    // clear for the patched words, which are then lifted by the stock lifter until the page is written again
+    bitmap->Allocate();
+    aarch64::PrescanRegistry::Get().Set(view->GetObject(), bitmap);
+    {
+      // Released along with the bitmap when the view is destroyed, it looks the bitmap up again on every write
+      PrescanNotification* notification = new PrescanNotification(this);
+      std::lock_guard<std::mutex> lock(mPrescanMutex);
+      mPrescanNotifications.emplace_back(view->GetObject(), notification);
+      view->RegisterNotification(notification);
+    }
+
+    // The reference keeps the view alive until the scan completes
+    Ref<BinaryView> scanned = view;
+    WorkerEnqueue(
+        [this, scanned, bitmap]() { ScanBitmap(scanned, *bitmap); },
+        "AArch64 prescan");
+  }
+
+  /**
+   * Scan all the chunks of a bitmap, one chunk per task on a pool of one thread per core
+   */
+  void ScanBitmap(BinaryView* view, aarch64::PrescanBitmap& bitmap) {
+    std::vector<aarch64::PrescanBitmap::Chunk> chunks =
+        bitmap.GetChunks(kPrescanChunkSlots);
+
+    std::atomic<size_t> next(0);
+    auto worker = [&]() {
+      std::vector<uint8_t> bytes;
+      std::vector<uint64_t> scratch;
+      for (size_t i; (i = next.fetch_add(1)) < chunks.size();) {
+        ScanChunk(view, bitmap, chunks[i], bytes, scratch);
+      }
+    };
+
+    size_t threadCount = std::min<size_t>(
+        std::max(std::thread::hardware_concurrency(), 1u), chunks.size());
+    std::vector<std::thread> threads;
+    for (size_t i = 1; i < threadCount; i++) {
+      threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+  }
+
+  /**
+   * Drop the prescan bitmap and the notification of a view being destroyed
+   */
+  void ReleasePrescan(BinaryView* view) {
+    aarch64::PrescanRegistry::Get().Set(view->GetObject(), nullptr);
+
+    BinaryDataNotification* notification = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mPrescanMutex);
+      for (auto it = mPrescanNotifications.begin();
+           it != mPrescanNotifications.end(); ++it) {
+        if (it->first == view->GetObject()) {
+          notification = it->second;
+          mPrescanNotifications.erase(it);
+          break;
+        }
+      }
+    }
+
+    if (notification != nullptr) {
+      view->UnregisterNotification(notification);
+      delete notification;
+    }
+  }
+
+  /**
+   * Scan the pages overlapping a write to a view again. Their bits are set first, so that the words being patched are
+   * decoded in the meantime
+   */
+  void RescanPages(BinaryView* view, uint64_t offset, size_t len) {
+    std::shared_ptr<aarch64::PrescanBitmap> bitmap =
+        aarch64::PrescanRegistry::Get().Find(view->GetObject());
+    if (!bitmap) {
+      return;
+    }
+
+    std::vector<uint8_t> bytes;
+    std::vector<uint64_t> scratch;
+    for (const aarch64::PrescanBitmap::Chunk& page :
+         bitmap->GetPages(offset, len)) {
+      bitmap->Invalidate(page);
+      ScanChunk(view, *bitmap, page, bytes, scratch);
+    }
+  }
+
+  /**
+   * Prescan bitmap of the view of an IL function
+   *
+   * @return bitmap, or nullptr if the view was not scanned or the function has none, e.g. when lifting headless
+   */
+  static const aarch64::PrescanBitmap* GetPrescan(LowLevelILFunction& il) {
+    ThreadState& state = GetThreadState();
+    aarch64::PrescanRegistry& registry = aarch64::PrescanRegistry::Get();
+    uint64_t generation = registry.GetGeneration();
+    if (!state.prescanFunction ||
+        il.GetObject() != state.prescanFunction->GetObject() ||
+        generation != state.prescanGeneration) {
+      state.prescanFunction = new LowLevelILFunction(
+          BNNewLowLevelILFunctionReference(il.GetObject()));
+      state.prescanGeneration = generation;
+
+      Ref<Function> function = il.GetFunction();
+      Ref<BinaryView> view = function ? function->GetView() : nullptr;
+      state.prescan = view ? registry.Find(view->GetObject()) : nullptr;
+    }
+
+    return state.prescan.get();
+  }
+
+  /**
+   * Read bytes of the view of an IL function, for the instructions past those the core handed over
+   *
+   * @return number of bytes read, 0 if the function has no view, e.g. when lifting headless
+   */
+  static size_t ReadView(LowLevelILFunction& il, uint64_t addr, uint8_t* dest,
+                         size_t len) {
+    Ref<Function> function = il.GetFunction();
+    Ref<BinaryView> view = function ? function->GetView() : nullptr;
+    return view ? view->Read(dest, addr, len) : 0;
+  }
+
+  /**
+   * Read the instruction words following the one being lifted, from the bytes the core handed over if there are enough
+   * of them, or else from the view, since the core hands over a single instruction when lifting
+   *
+   * @param count number of words, up to 4
+   * @return false if fewer than count words follow
+   */
+  static bool ReadFollowing(LowLevelILFunction& il, uint32_t* words,
+                            size_t count) {
+    const ThreadState& state = GetThreadState();
+    const uint8_t* following = state.following;
+    uint8_t bytes[16];
+    if (state.followingLength < count * 4) {
+      if (count * 4 > sizeof(bytes) ||
+          ReadView(il, il.GetCurrentAddress() + 4, bytes, count * 4) !=
+              count * 4) {
+        return false;
+      }
+      following = bytes;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      words[i] = ReadWord(following + i * 4);
+    }
+    return true;
+  }
+
+  /**
+   * Decode an instruction into a decode cache entry claimed for it
+   */
+  void Fill(aarch64::DecodeCacheEntry& entry, const uint8_t* data,
+            uint64_t addr, uint32_t word) {
+    // Stores hold the decoding against every encoding class, and whether a lifter handles it only depends on the
+    // opcode, so the verdict is that of the current settings
+    const aarch64::Instruction* stored =
+        mPersistDecodes ? FindStored(addr, word) : nullptr;
+    if (stored != nullptr) {
+      entry.instr = *stored;
+      entry.verdict =
+          mLifters[0][static_cast<size_t>(entry.instr.opcode)] != nullptr
+              ? aarch64::Verdict::Supported
+              : aarch64::Verdict::Unsupported;
+      GetThreadState().statistics.Add(aarch64::kStoreHits);
+      return;
+    }
+
+    if (!aarch64::Decode(word, entry.instr, mEncodingClasses,
+                         mEncodingClassCount)) {
+      entry.instr.opcode = aarch64::Opcode::Invalid;
+      entry.verdict = aarch64::Verdict::Unsupported;
+      return;
+    }
+
+#ifdef AARCH64_CAPSTONE_CROSSCHECK
+    CrossCheck(data, addr, entry.instr);
+#else
+    (void) data;
+    (void) addr;
+#endif
+
+    entry.verdict =
+        mLifters[0][static_cast<size_t>(entry.instr.opcode)] != nullptr
+            ? aarch64::Verdict::Supported
+            : aarch64::Verdict::Unsupported;
+  }
+
+  /**
+   * Decode the instruction at addr through the per-thread decode cache. Meant to be shared by every callback of the
+   * extension that needs the decoded form of an instruction
+   *
+   * @param data instruction bytes
+   * @param addr address of the instruction
+   * @param len number of bytes available at data, instructions past the first are decoded ahead into the cache
+   * @param il IL function being lifted, whose view holds the instructions to decode ahead past the bytes at data
+   * @return decode cache entry, valid until the next call on the same thread, or nullptr if data is too short to hold
+   * an instruction
+   */
+  const aarch64::DecodeCacheEntry* Decode(const uint8_t* data, uint64_t addr,
+                                          size_t len,
+                                          LowLevelILFunction* il = nullptr) {
+    if (len < 4) {
+      return nullptr;
+    }
+
+    uint32_t word = ReadWord(data);
+
+    ThreadState& state = GetThreadState();
+    aarch64::DecodeCache& decodeCache = state.decodeCache;
+    aarch64::ThreadStatistics& statistics = state.statistics;
+    aarch64::DecodeCacheEntry* cached = decodeCache.Lookup(addr, word);
+    if (cached != nullptr) {
+      statistics.Add(aarch64::kCacheHits);
+      if (cached->prefetched) {
+        cached->prefetched = false;
+        statistics.Add(aarch64::kPrefetchHits);
+      }
+      return cached;
+    }
+
+    statistics.Add(aarch64::kCacheMisses);
+
+    aarch64::DecodeCacheEntry& entry = decodeCache.Insert(addr, word);
+    Fill(entry, data, addr, word);
+
+    if (mPrefetchDepth == 0 || aarch64::IsBranch(word)) {
+      return &entry;
+    }
+
+    // Decode the rest of the straight-line run in one pass, so that the calls for the next addresses hit. The core
+    // hands over a single instruction when lifting, the run is then read from the view
+    const uint8_t* run = data + 4;
+    size_t runLength = len - 4;
+    if (runLength < mPrefetchDepth * 4 && il != nullptr) {
+      std::vector<uint8_t>& bytes = state.prefetchBytes;
+      bytes.resize(mPrefetchDepth * 4);
+      runLength = ReadView(*il, addr + 4, bytes.data(), bytes.size());
+      run = bytes.data();
+    }
+
+    size_t ahead = std::min(mPrefetchDepth, runLength / 4);
+    for (size_t i = 1; i <= ahead && !aarch64::IsBranch(word); i++) {
+      const uint8_t* next = run + (i - 1) * 4;
+      word = ReadWord(next);
+      if (decodeCache.Lookup(addr + i * 4, word) != nullptr) {
+        continue;
+      }
+
+      aarch64::DecodeCacheEntry& prefetched =
+          decodeCache.Insert(addr + i * 4, word);
+      Fill(prefetched, next, addr + i * 4, word);
+      prefetched.prefetched = true;
+      statistics.Add(aarch64::kPrefetched);
+    }
+
+    return &entry;
+  }
+
+  bool LiftCSINC(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? Rn : Rm + 1
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond, [&] { return ReadGpr(size, instr.rn); },
+        [&] {
+          return FoldAdd(il, size, ReadGpr(size, instr.rm), Constant(1));
+        });
+
+    return true;
+  }
+
+  bool LiftCSEL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? Rn : Rm
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond, [&] { return ReadGpr(size, instr.rn); },
+        [&] { return ReadGpr(size, instr.rm); });
+
+    return true;
+  }
+
+  bool LiftCSET(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // Rd = cond, already straight-line in either lifting mode
+    SetGpr(il, instr.size, instr.rd,
+           Expression(il.BoolToInt(instr.size,
+                                   ConditionExpression(il, instr.cond))));
+
+    return true;
+  }
+
+  bool LiftCSINV(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? Rn : ~Rm
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond, [&] { return ReadGpr(size, instr.rn); },
+        [&] { return FoldNot(il, size, ReadGpr(size, instr.rm)); });
+
+    return true;
+  }
+
+  bool LiftCINV(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? ~Rn : Rn
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond,
+        [&] { return FoldNot(il, size, ReadGpr(size, instr.rn)); },
+        [&] { return ReadGpr(size, instr.rn); });
+
+    return true;
+  }
+
+  bool LiftCSETM(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // Rd = -cond, already straight-line in either lifting mode
+    ExprId condition =
+        il.BoolToInt(instr.size, ConditionExpression(il, instr.cond));
+    SetGpr(il, instr.size, instr.rd,
+           Expression(il.Neg(instr.size, condition)));
+
+    return true;
+  }
+
+  bool LiftCSNEG(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? Rn : -Rm
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond, [&] { return ReadGpr(size, instr.rn); },
+        [&] { return FoldNeg(il, size, ReadGpr(size, instr.rm)); });
+
+    return true;
+  }
+
+  bool LiftCNEG(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    // Rd = cond ? -Rn : Rn
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond,
+        [&] { return FoldNeg(il, size, ReadGpr(size, instr.rn)); },
+        [&] { return ReadGpr(size, instr.rn); });
+
+    return true;
+  }
+
+  enum class Multiply { Same, SignedWidening, UnsignedWidening };
+
+  /**
+   * Build Rn * Rm of the multiply family, the widening forms multiply the W registers into a double precision product
+   */
+  ExprId LiftProduct(const aarch64::Instruction& instr, LowLevelILFunction& il,
+                     Multiply multiply) {
+    if (multiply == Multiply::Same) {
+      const RegisterOperand& Rn = Gpr(instr.size, instr.rn);
+      const RegisterOperand& Rm = Gpr(instr.size, instr.rm);
+      return il.Mult(instr.size, il.Register(Rn.size, Rn.id),
+                     il.Register(Rm.size, Rm.id));
+    }
+
+    const RegisterOperand& Wn = Gpr(4, instr.rn);
+    const RegisterOperand& Wm = Gpr(4, instr.rm);
+    // The size of the double precision operations is the size of the product
+    if (multiply == Multiply::SignedWidening) {
+      return il.MultDoublePrecSigned(8, il.Register(4, Wn.id),
+                                     il.Register(4, Wm.id));
+    }
+    return il.MultDoublePrecUnsigned(8, il.Register(4, Wn.id),
+                                     il.Register(4, Wm.id));
+  }
+
+  /**
+   * Rd = Ra + product, or Ra - product
+   */
+  void LiftAccumulate(const aarch64::Instruction& instr, LowLevelILFunction& il,
+                      ExprId product, bool subtract) {
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+    const RegisterOperand& Ra = Gpr(instr.size, instr.ra);
+    ExprId accumulator = il.Register(Ra.size, Ra.id);
+
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id,
+        subtract ? il.Sub(Rd.size, accumulator, product)
+                 : il.Add(Rd.size, accumulator, product)));
+  }
+
+  /**
+   * Record a multiplication by a constant of UMULL or UMULH, which may be the first half of an unsigned division, or
+   * of SMULL or SMULH, which may start a signed division
+   */
+  void RecordProduct(const aarch64::Instruction& instr, unsigned int bits,
+                     bool isSigned = false) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+
+    // One factor must be a known constant, read before the product overwrites it, and the other must survive the
+    // multiplication
+    uint64_t magic;
+    uint8_t dividend;
+    bool constant = true;
+    if (instr.rd != instr.rn && sequence.GetValue(instr.rm, magic)) {
+      dividend = instr.rn;
+    } else if (instr.rd != instr.rm && sequence.GetValue(instr.rn, magic)) {
+      dividend = instr.rm;
+    } else {
+      constant = false;
+    }
+
+    sequence.Clear(instr.rd);
+    if (!constant || instr.rd == 31) {
+      return;
+    }
+
+    magic &= Ones<uint64_t>(bits);
+    if (!isSigned) {
+      sequence.SetProduct(
+          {instr.rd, dividend, static_cast<uint8_t>(bits), magic});
+    } else if (dividend != 31) {
+      // SMULH keeps the high half of the product, SMULL all of it
+      sequence.SetSignedProduct(
+          instr.rd, {dividend, static_cast<uint8_t>(bits), magic},
+          bits == 64 ? 64 : 0);
+    }
+  }
+
+  /**
+   * Returns true if the top bit of a register is the sign of the dividend of the signed division in progress, when
+   * read at the given size
+   */
+  bool HasDividendSign(uint8_t reg, size_t size) const {
+    const aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    aarch64::SequenceTracker::SignedDivision division;
+    unsigned int shift;
+    if (!sequence.GetSignedDivision(division)) {
+      return false;
+    } else if (reg == division.dividend) {
+      return size * 8 == division.bits;
+    }
+
+    // A product by a positive magic number has the sign of the dividend, and so does its low word once shifted
+    // right enough to fit in it
+    return sequence.GetEstimate(reg, size, shift) &&
+           (size == 8 || (size * 8 == division.bits && shift >= division.bits));
+  }
+
+  /**
+   * Match the last instruction of a signed division by a constant, which adds the sign bit of the dividend to the
+   * shifted product: ADD Rd, Rq, Rs, LSR #(bits - 1), SUB Rd, Rq, Rs, ASR #(bits - 1), or ADD Rd, Rq, Rs of a sign
+   * bit extracted beforehand
+   *
+   * @param dividend register of the dividend
+   * @param divisor recovered divisor
+   */
+  bool FindSignedQuotient(const aarch64::Instruction& instr, bool subtract,
+                          uint8_t& dividend, uint64_t& divisor) const {
+    const aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    aarch64::SequenceTracker::SignedDivision division;
+    unsigned int bits = instr.size * 8;
+    if (!sequence.GetSignedDivision(division) || division.bits != bits) {
+      return false;
+    }
+
+    // The sign bit may be either operand of a plain ADD
+    uint8_t quotient = instr.rn;
+    uint8_t sign = instr.rm;
+    bool signBit;
+    if (instr.imms == 0) {
+      if (!subtract && sequence.IsSignBit(quotient)) {
+        std::swap(quotient, sign);
+      }
+      signBit = !subtract && sequence.IsSignBit(sign);
+    } else {
+      signBit = instr.imms == bits - 1 &&
+                instr.immr == (subtract ? aarch64::kShiftAsr
+                                        : aarch64::kShiftLsr) &&
+                HasDividendSign(sign, instr.size);
+    }
+
+    unsigned int shift;
+    if (!signBit || !sequence.GetEstimate(quotient, instr.size, shift) ||
+        !aarch64::FindSignedDivisor(division.magic, bits, shift, divisor)) {
+      return false;
+    }
+
+    dividend = division.dividend;
+    return true;
+  }
+
+  bool LiftMADD(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il, LiftProduct(instr, il, Multiply::Same), false);
+
+    return true;
+  }
+
+  bool LiftMUL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id, LiftProduct(instr, il, Multiply::Same)));
+
+    return true;
+  }
+
+  bool LiftMSUB(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il, LiftProduct(instr, il, Multiply::Same), true);
+
+    return true;
+  }
+
+  bool LiftMNEG(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id,
+        il.Neg(Rd.size, LiftProduct(instr, il, Multiply::Same))));
+
+    return true;
+  }
+
+  bool LiftSMADDL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il,
+                   LiftProduct(instr, il, Multiply::SignedWidening), false);
+
+    return true;
+  }
+
+  bool LiftSMULL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id, LiftProduct(instr, il, Multiply::SignedWidening)));
+    RecordProduct(instr, 32, true);
+
+    return true;
+  }
+
+  bool LiftSMSUBL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il,
+                   LiftProduct(instr, il, Multiply::SignedWidening), true);
+
+    return true;
+  }
+
+  bool LiftSMNEGL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id,
+        il.Neg(8, LiftProduct(instr, il, Multiply::SignedWidening))));
+
+    return true;
+  }
+
+  bool LiftUMADDL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il,
+                   LiftProduct(instr, il, Multiply::UnsignedWidening), false);
+
+    return true;
+  }
+
+  bool LiftUMULL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id, LiftProduct(instr, il, Multiply::UnsignedWidening)));
+    RecordProduct(instr, 32);
+
+    return true;
+  }
+
+  bool LiftUMSUBL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    LiftAccumulate(instr, il,
+                   LiftProduct(instr, il, Multiply::UnsignedWidening), true);
+
+    return true;
+  }
+
+  bool LiftUMNEGL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id,
+        il.Neg(8, LiftProduct(instr, il, Multiply::UnsignedWidening))));
+
+    return true;
+  }
+
+  bool LiftSMULH(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+    const RegisterOperand& Xn = Gpr(8, instr.rn);
+    const RegisterOperand& Xm = Gpr(8, instr.rm);
+
+    // Xd = (Xn * Xm) >> 64, on the 128-bit product
+    ExprId product = il.MultDoublePrecSigned(16, il.Register(8, Xn.id),
+                                             il.Register(8, Xm.id));
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id,
+        il.LowPart(8, il.LogicalShiftRight(16, product, il.Const(1, 64)))));
+    RecordProduct(instr, 64, true);
+
+    return true;
+  }
+
+  bool LiftUMULH(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+    const RegisterOperand& Xn = Gpr(8, instr.rn);
+    const RegisterOperand& Xm = Gpr(8, instr.rm);
+
+    // Xd = (Xn * Xm) >> 64, on the 128-bit product
+    ExprId product = il.MultDoublePrecUnsigned(16, il.Register(8, Xn.id),
+                                               il.Register(8, Xm.id));
+    il.AddInstruction(il.SetRegister(
+        8, Xd.id,
+        il.LowPart(8, il.LogicalShiftRight(16, product, il.Const(1, 64)))));
+    RecordProduct(instr, 64);
+
+    return true;
+  }
+
+  /**
+   * Total right shift of the full product of a recorded multiplication, UMULH already dropped its low 64 bits
+   */
+  static unsigned int ProductShift(
+      const aarch64::SequenceTracker::Product& product, uint64_t shift) {
+    return static_cast<unsigned int>(shift) + (product.bits == 64 ? 64 : 0);
+  }
+
+  template <size_t Size>
+  bool LiftLSR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rd = Gpr(Size, instr.rd);
+    const RegisterOperand& Rn = Gpr(Size, instr.rn);
+
+    // Second half of a division by a constant, after UMULH or a 32-bit UMULL: Rd = dividend / divisor
+    if constexpr (Size == 8) {
+      aarch64::SequenceTracker::Product product;
+      uint64_t divisor;
+      if (sequence.GetProduct(instr.rn, product) &&
+          aarch64::FindUnsignedDivisor(product.magic, product.bits,
+                                       ProductShift(product, instr.imm),
+                                       divisor)) {
+        const RegisterOperand& dividend =
+            Gpr(product.bits / 8, product.dividend);
+        ExprId quotient = il.DivUnsigned(
+            dividend.size, il.Register(dividend.size, dividend.id),
+            il.Const(dividend.size, divisor));
+        if (dividend.size != 8) {
+          quotient = il.ZeroExtend(8, quotient);
+        }
+
+        il.AddInstruction(il.SetRegister(8, Rd.id, quotient));
+        sequence.Clear(instr.rd);
+        return true;
+      }
+    }
+
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id,
+        il.LogicalShiftRight(Rd.size, il.Register(Rn.size, Rn.id),
+                             il.Const(1, instr.imm))));
+    // The sign bit of the dividend of a signed division, added to the quotient by a later ADD
+    aarch64::SequenceTracker::SignedDivision division;
+    unsigned int shift;
+    if (instr.imm == Size * 8 - 1 && HasDividendSign(instr.rn, Size)) {
+      sequence.SetSignBit(instr.rd);
+    } else if (Size == 8 && sequence.GetSignedDivision(division) &&
+               division.bits == 32 &&
+               sequence.GetEstimate(instr.rn, Size, shift) &&
+               shift + instr.imm <= 32) {
+      // The product of a 32-bit division shifted right by 32 as a whole, as for x / 3 or x / 6, and later read as a W
+      // register: up to a shift of 32, its low word is the same as after an arithmetic shift
+      sequence.SetEstimate(instr.rd,
+                           shift + static_cast<unsigned int>(instr.imm), true);
+    } else {
+      sequence.Clear(instr.rd);
+    }
+
+    return true;
+  }
+
+  bool LiftCINC(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+
+    if (mFlatConditionalSelect && instr.rd != 31) {
+      // Rd = Rn + cond
+      ExprId condition =
+          il.BoolToInt(size, ConditionExpression(il, instr.cond));
+      SetGpr(il, size, instr.rd,
+             FoldAdd(il, size, ReadGpr(size, instr.rn), Expression(condition)));
+      return true;
+    }
+
+    // Rd = cond ? Rn + 1 : Rn
+    LiftConditionalSelect(
+        il, size, instr.rd, instr.cond,
+        [&] { return FoldAdd(il, size, ReadGpr(size, instr.rn), Constant(1)); },
+        [&] { return ReadGpr(size, instr.rn); });
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftBFI(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    constexpr uint64_t ones = Ones<uint64_t>(Size * 8);
+    uint64_t inclusion_mask = BitfieldMask(instr.lsb, instr.width);
+
+    // Rd = (Rd & ~mask) | ((Rn << lsb) & mask), an inserted zero register only clears the field
+    Value left = FoldAnd(il, Size, ReadGpr(Size, instr.rd),
+                         Constant(~inclusion_mask & ones));
+    Value right = FoldAnd(il, Size,
+                          FoldShiftLeft(il, Size, ReadGpr(Size, instr.rn),
+                                        instr.lsb),
+                          Constant(inclusion_mask));
+    SetGpr(il, Size, instr.rd, FoldOr(il, Size, left, right));
+
+    return true;
+  }
+
+  /**
+   * Mask of the width bits starting at lsb, shared by the bitfield lifters
+   */
+  static uint64_t BitfieldMask(unsigned int lsb, unsigned int width) {
+    return Ones<uint64_t>(width) << lsb;
+  }
+
+  /**
+   * Bits [lsb, lsb + width) of a value moved to bit 0, zero- or sign-extended to Size. A byte, halfword or word field
+   * is a single extension of a low part, any other field a single masked shift, or a pair of shifts when signed
+   */
+  template <size_t Size>
+  static Value ExtractField(LowLevelILFunction& il, const Value& source,
+                            unsigned int lsb, unsigned int width, bool sign) {
+    constexpr size_t size = Size;
+    constexpr unsigned int bits = Size * 8;
+    if (source.kind == Value::Kind::Constant) {
+      uint64_t field = (source.constant >> lsb) & BitfieldMask(0, width);
+      if (sign && (field >> (width - 1) & 1)) {
+        field |= ~BitfieldMask(0, width);
+      }
+      return Constant(field & Ones<uint64_t>(bits));
+    }
+
+    // A field reaching the top bit needs no mask
+    if (lsb + width == bits) {
+      return sign ? FoldArithShiftRight(il, size, source, lsb)
+                  : FoldLogicalShiftRight(il, size, source, lsb);
+    }
+
+    if (width == 8 || width == 16 || width == 32) {
+      Value shifted = FoldLogicalShiftRight(il, size, source, lsb);
+      ExprId part = il.LowPart(width / 8, Emit(il, size, shifted));
+      return Expression(sign ? il.SignExtend(size, part)
+                             : il.ZeroExtend(size, part));
+    }
+
+    if (!sign) {
+      return FoldAnd(il, size, FoldLogicalShiftRight(il, size, source, lsb),
+                     Constant(BitfieldMask(0, width)));
+    }
+
+    // Move the field to the top, then shift it back down with its sign
+    return FoldArithShiftRight(
+        il, size, FoldShiftLeft(il, size, source, bits - lsb - width),
+        bits - width);
+  }
+
+  /**
+   * Insert the low width bits of a value at lsb, bits above the field are zero- or sign-extended and bits below the
+   * field are zero
+   */
+  template <size_t Size>
+  static Value InsertField(LowLevelILFunction& il, const Value& source,
+                           unsigned int lsb, unsigned int width, bool sign) {
+    constexpr size_t size = Size;
+    constexpr unsigned int bits = Size * 8;
+    // The shift already drops every bit above the field
+    if (lsb + width == bits) {
+      return FoldShiftLeft(il, size, source, lsb);
+    }
+
+    if (sign && width != 8 && width != 16 && width != 32 &&
+        source.kind != Value::Kind::Constant) {
+      // Move the field to the top, then shift it down to lsb with its sign
+      return FoldArithShiftRight(
+          il, size, FoldShiftLeft(il, size, source, bits - width),
+          bits - width - lsb);
+    }
+
+    return FoldShiftLeft(il, size,
+                         ExtractField<Size>(il, source, 0, width, sign), lsb);
+  }
+
+  template <size_t Size>
+  bool LiftBFXIL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    constexpr uint64_t ones = Ones<uint64_t>(Size * 8);
+
+    // Rd = (Rd & ~Ones(width)) | Rn<lsb + width - 1:lsb>
+    Value kept = FoldAnd(il, Size, ReadGpr(Size, instr.rd),
+                         Constant(~BitfieldMask(0, instr.width) & ones));
+    Value field = ExtractField<Size>(il, ReadGpr(Size, instr.rn), instr.lsb,
+                                     instr.width, false);
+    SetGpr(il, Size, instr.rd, FoldOr(il, Size, kept, field));
+
+    return true;
+  }
+
+  /**
+   * UBFX, and UXTB and UXTH as the extracts of the low byte and halfword
+   */
+  template <size_t Size>
+  bool LiftUBFX(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetGpr(il, Size, instr.rd,
+           ExtractField<Size>(il, ReadGpr(Size, instr.rn), instr.lsb,
+                              instr.width, false));
+
+    return true;
+  }
+
+  /**
+   * SBFX, and SXTB, SXTH and SXTW as the extracts of the low byte, halfword and word
+   */
+  template <size_t Size>
+  bool LiftSBFX(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // SXTW reads the W register, the same low bits as the X register
+    SetGpr(il, Size, instr.rd,
+           ExtractField<Size>(il, ReadGpr(Size, instr.rn), instr.lsb,
+                              instr.width, true));
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftUBFIZ(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetGpr(il, Size, instr.rd,
+           InsertField<Size>(il, ReadGpr(Size, instr.rn), instr.lsb,
+                             instr.width, false));
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftSBFIZ(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetGpr(il, Size, instr.rd,
+           InsertField<Size>(il, ReadGpr(Size, instr.rn), instr.lsb,
+                             instr.width, true));
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftLSL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetGpr(il, Size, instr.rd,
+           FoldShiftLeft(il, Size, ReadGpr(Size, instr.rn),
+                         static_cast<unsigned int>(instr.imm)));
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftASR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+
+    // A signed division shifts its product right, as a whole or after SMULH dropped the low half
+    unsigned int shift;
+    bool estimate = Size == 8 && sequence.GetEstimate(instr.rn, Size, shift);
+    SetGpr(il, Size, instr.rd,
+           FoldArithShiftRight(il, Size, ReadGpr(Size, instr.rn),
+                               static_cast<unsigned int>(instr.imm)));
+    if (estimate) {
+      sequence.SetEstimate(instr.rd,
+                           shift + static_cast<unsigned int>(instr.imm));
+    }
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftEXTR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    constexpr size_t size = Size;
+    unsigned int lsb = instr.imms;
+
+    // Rd = (Rn:Rm)<lsb + bits - 1:lsb>, which is Rm at lsb 0
+    Value value = ReadGpr(size, instr.rm);
+    if (lsb != 0) {
+      value = FoldOr(il, size, FoldLogicalShiftRight(il, size, value, lsb),
+                     FoldShiftLeft(il, size, ReadGpr(size, instr.rn),
+                                   size * 8 - lsb));
+    }
+    SetGpr(il, size, instr.rd, value);
+
+    return true;
+  }
+
+  template <size_t Size>
+  bool LiftROR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    constexpr size_t size = Size;
+
+    // A rotation by 0 is a register copy
+    Value shift = instr.hasImmediate ? Constant(instr.imm)
+                                     : ReadGpr(size, instr.rm);
+    SetGpr(il, size, instr.rd,
+           FoldRotateRight(il, size, ReadGpr(size, instr.rn), shift));
+
+    return true;
+  }
+
+  bool LiftVADD(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id,
+                 aarch64::OffsetIntrinsic(
+                     aarch64::Intrinsic::VAdd8B,
+                     aarch64::GetArrangementIndex(instr.size, instr.esize)),
+                 {VectorRegister(il, instr.size, instr.rn),
+                  VectorRegister(il, instr.size, instr.rm)});
+
+    return true;
+  }
+
+  bool LiftVSUB(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id,
+                 aarch64::OffsetIntrinsic(
+                     aarch64::Intrinsic::VSub8B,
+                     aarch64::GetArrangementIndex(instr.size, instr.esize)),
+                 {VectorRegister(il, instr.size, instr.rn),
+                  VectorRegister(il, instr.size, instr.rm)});
+
+    return true;
+  }
+
+  bool LiftVAND(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetVectorRegister(
+        il, instr.size, instr.rd,
+        il.And(instr.size, VectorRegister(il, instr.size, instr.rn),
+               VectorRegister(il, instr.size, instr.rm)));
+
+    return true;
+  }
+
+  bool LiftVBIC(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // Immediate form: Vd = Vd & ~imm
+    if (instr.hasImmediate) {
+      SetVectorRegister(
+          il, instr.size, instr.rd,
+          il.And(instr.size, VectorRegister(il, instr.size, instr.rd),
+                 VectorConstant(il, instr.size, ~instr.imm)));
+      return true;
+    }
+
+    SetVectorRegister(
+        il, instr.size, instr.rd,
+        il.And(instr.size, VectorRegister(il, instr.size, instr.rn),
+               il.Not(instr.size, VectorRegister(il, instr.size, instr.rm))));
+
+    return true;
+  }
+
+  bool LiftVORR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // Immediate form: Vd = Vd | imm
+    if (instr.hasImmediate) {
+      SetVectorRegister(
+          il, instr.size, instr.rd,
+          il.Or(instr.size, VectorRegister(il, instr.size, instr.rd),
+                VectorConstant(il, instr.size, instr.imm)));
+      return true;
+    }
+
+    SetVectorRegister(
+        il, instr.size, instr.rd,
+        il.Or(instr.size, VectorRegister(il, instr.size, instr.rn),
+              VectorRegister(il, instr.size, instr.rm)));
+
+    return true;
+  }
+
+  bool LiftVMOV(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetVectorRegister(il, instr.size, instr.rd,
+                      VectorRegister(il, instr.size, instr.rn));
+
+    return true;
+  }
+
+  bool LiftVEOR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetVectorRegister(
+        il, instr.size, instr.rd,
+        il.Xor(instr.size, VectorRegister(il, instr.size, instr.rn),
+               VectorRegister(il, instr.size, instr.rm)));
+
+    return true;
+  }
+
+  bool LiftDUP(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    auto element = [&] {
+      if (!instr.hasLane) {
+        const RegisterOperand& Rn = Gpr(instr.esize == 8 ? 8 : 4, instr.rn);
+        ExprId value = il.Register(Rn.size, Rn.id);
+        return Rn.size == instr.esize ? value : il.LowPart(instr.esize, value);
+      }
+
+      ExprId value = VectorRegister(il, 16, instr.rn);
+      if (instr.lane != 0) {
+        value = il.LogicalShiftRight(
+            16, value, il.Const(1, instr.lane * instr.esize * 8));
+      }
+      return il.LowPart(instr.esize, value);
+    };
+
+    SetVectorRegister(il, instr.size, instr.rd,
+                      Broadcast(il, instr.size, instr.esize, element));
+
+    return true;
+  }
+
+  bool LiftMOVI(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetVectorRegister(il, instr.size, instr.rd,
+                      VectorConstant(il, instr.size, instr.imm));
+
+    return true;
+  }
+
+  bool LiftMVNI(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    SetVectorRegister(il, instr.size, instr.rd,
+                      VectorConstant(il, instr.size, ~instr.imm));
+
+    return true;
+  }
+
+  bool LiftEXT(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    if (instr.imm == 0) {
+      return LiftVMOV(instr, il);
+    }
+
+    // Vd = (Vm:Vn) >> (imm * 8), i.e. the low bytes of Vm above the high bytes of Vn
+    ExprId low = il.LogicalShiftRight(instr.size,
+                                      VectorRegister(il, instr.size, instr.rn),
+                                      il.Const(1, instr.imm * 8));
+    ExprId high = il.ShiftLeft(instr.size,
+                               VectorRegister(il, instr.size, instr.rm),
+                               il.Const(1, (instr.size - instr.imm) * 8));
+    SetVectorRegister(il, instr.size, instr.rd, il.Or(instr.size, low, high));
+
+    return true;
+  }
+
+  bool LiftTBL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    std::vector<ExprId> params;
+    for (unsigned int i = 0; i < instr.count; i++) {
+      params.push_back(VectorRegister(il, 16, instr.rn + i));
+    }
+    params.push_back(VectorRegister(il, instr.size, instr.rm));
+
+    AddIntrinsic(il, Vr(16, instr.rd).id,
+                 aarch64::OffsetIntrinsic(aarch64::Intrinsic::Tbl1x8B,
+                                          (instr.count - 1) * 2 +
+                                              (instr.size == 16)),
+                 params);
+
+    return true;
+  }
+
+  /**
+   * Post-increment the base register of LD1 and ST1
+   */
+  void LiftWriteback(const aarch64::Instruction& instr,
+                     LowLevelILFunction& il) {
+    if (!instr.writeback) {
+      return;
+    }
+
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    ExprId offset;
+    if (instr.hasImmediate) {
+      offset = il.Const(8, instr.imm);
+    } else {
+      const RegisterOperand& Xm = Gpr(8, instr.rm);
+      offset = il.Register(Xm.size, Xm.id);
+    }
+
+    il.AddInstruction(il.SetRegister(
+        8, Xn.id, il.Add(8, il.Register(Xn.size, Xn.id), offset)));
+    GetThreadState().sequence.Clear(instr.rn);
+  }
+
+  /**
+   * Address of the i-th register of the list of LD1 and ST1, in memory the registers are contiguous and so are the
+   * elements of each register
+   */
+  ExprId ListAddress(const aarch64::Instruction& instr, LowLevelILFunction& il,
+                     unsigned int i) {
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    if (i == 0) {
+      return il.Register(Xn.size, Xn.id);
+    }
+    return il.Add(8, il.Register(Xn.size, Xn.id),
+                  il.Const(8, i * instr.size));
+  }
+
+  bool LiftLD1(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    for (unsigned int i = 0; i < instr.count; i++) {
+      SetVectorRegister(il, instr.size, instr.rd + i,
+                        il.Load(instr.size, ListAddress(instr, il, i)));
+    }
+    LiftWriteback(instr, il);
+
+    return true;
+  }
+
+  bool LiftST1(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    for (unsigned int i = 0; i < instr.count; i++) {
+      il.AddInstruction(
+          il.Store(instr.size, ListAddress(instr, il, i),
+                   VectorRegister(il, instr.size, instr.rd + i)));
+    }
+    LiftWriteback(instr, il);
+    GetThreadState().sequence.ClearLoads();
+
+    return true;
+  }
+
+  /**
+   * Intrinsic of an instruction of the cryptographic extension, from AESE to SHA512SU0
+   */
+  static aarch64::Intrinsic GetCryptoIntrinsic(aarch64::Opcode opcode) {
+    return aarch64::OffsetIntrinsic(
+        aarch64::Intrinsic::Aese,
+        static_cast<uint32_t>(opcode) -
+            static_cast<uint32_t>(aarch64::Opcode::AESE));
+  }
+
+  // AESE, AESD, SHA1SU1, SHA256SU0 and SHA512SU0: Vd = op(Vd, Vn)
+  bool LiftCryptoBinary(const aarch64::Instruction& instr,
+                        LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id, GetCryptoIntrinsic(instr.opcode),
+                 {VectorRegister(il, 16, instr.rd),
+                  VectorRegister(il, 16, instr.rn)});
+
+    return true;
+  }
+
+  // AESMC and AESIMC: Vd = op(Vn)
+  bool LiftCryptoUnary(const aarch64::Instruction& instr,
+                       LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id, GetCryptoIntrinsic(instr.opcode),
+                 {VectorRegister(il, 16, instr.rn)});
+
+    return true;
+  }
+
+  // SHA1SU0, SHA256H, SHA256H2, SHA256SU1, SHA512H, SHA512H2 and SHA512SU1: Vd = op(Vd, Vn, Vm)
+  bool LiftCryptoTernary(const aarch64::Instruction& instr,
+                         LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id, GetCryptoIntrinsic(instr.opcode),
+                 {VectorRegister(il, 16, instr.rd),
+                  VectorRegister(il, 16, instr.rn),
+                  VectorRegister(il, 16, instr.rm)});
+
+    return true;
+  }
+
+  // SHA1C, SHA1P and SHA1M: Qd = op(Qd, Sn, Vm)
+  bool LiftSHA1C(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id, GetCryptoIntrinsic(instr.opcode),
+                 {VectorRegister(il, 16, instr.rd),
+                  il.LowPart(4, VectorRegister(il, 16, instr.rn)),
+                  VectorRegister(il, 16, instr.rm)});
+
+    return true;
+  }
+
+  // Sd = sha1h(Sn)
+  bool LiftSHA1H(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id, GetCryptoIntrinsic(instr.opcode),
+                 {il.LowPart(4, VectorRegister(il, 16, instr.rn))});
+
+    return true;
+  }
+
+  /**
+   * Source half of PMULL, the lower half of the register, or the upper half for PMULL2
+   */
+  ExprId PolynomialSource(const aarch64::Instruction& instr,
+                          LowLevelILFunction& il, unsigned int number) {
+    if (instr.opcode == aarch64::Opcode::PMULL) {
+      return VectorRegister(il, 8, number);
+    }
+
+    return il.LowPart(8, il.LogicalShiftRight(16,
+                                              VectorRegister(il, 16, number),
+                                              il.Const(1, 64)));
+  }
+
+  // PMULL and PMULL2
+  bool LiftPMULL(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddIntrinsic(il, Vr(16, instr.rd).id,
+                 instr.esize == 8 ? aarch64::Intrinsic::Pmull1Q
+                                  : aarch64::Intrinsic::Pmull8H,
+                 {PolynomialSource(instr, il, instr.rn),
+                  PolynomialSource(instr, il, instr.rm)});
+
+    return true;
+  }
+
+  /**
+   * Resolve the register of an ADD (immediate) operand, register number 31 is the stack pointer
+   */
+  const RegisterOperand& GprOrSp(size_t size, uint8_t number) const {
+    return number == 31 ? mStackPointers[size == 8] : Gpr(size, number);
+  }
+
+  /**
+   * Build the constant materialized by an instruction sequence
+   */
+  static ExprId SequenceConstant(LowLevelILFunction& il, size_t size,
+                                 uint64_t value, bool pointer) {
+    return pointer ? il.ConstPointer(size, value) : il.Const(size, value);
+  }
+
+  bool LiftADRP(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+    uint64_t page =
+        (il.GetCurrentAddress() & ~static_cast<uint64_t>(0xFFF)) + instr.imm;
+
+    il.AddInstruction(il.SetRegister(8, Xd.id, il.ConstPointer(8, page)));
+    sequence.SetValue(instr.rd, page, true);
+
+    return true;
+  }
+
+  /**
+   * Rd = Rn + (Rm shifted), or Rn - (Rm shifted), register 31 is the zero register
+   */
+  bool LiftAddSubRegister(const aarch64::Instruction& instr,
+                          LowLevelILFunction& il, bool subtract) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    size_t size = instr.size;
+
+    // Last instruction of a signed division by a constant: Rd = dividend / divisor
+    uint8_t dividend;
+    uint64_t divisor;
+    if (FindSignedQuotient(instr, subtract, dividend, divisor)) {
+      ExprId quotient =
+          il.DivSigned(size, Emit(il, size, ReadGpr(size, dividend)),
+                       il.Const(size, divisor));
+      SetGpr(il, size, instr.rd, Expression(quotient));
+      sequence.Clear(instr.rd);
+      return true;
+    }
+
+    Value operand = ReadGpr(size, instr.rm);
+    unsigned int shift = instr.imms;
+    if (instr.immr == aarch64::kShiftLsl) {
+      operand = FoldShiftLeft(il, size, operand, shift);
+    } else if (instr.immr == aarch64::kShiftLsr) {
+      operand = FoldLogicalShiftRight(il, size, operand, shift);
+    } else {
+      operand = FoldArithShiftRight(il, size, operand, shift);
+    }
+
+    Value n = ReadGpr(size, instr.rn);
+    SetGpr(il, size, instr.rd,
+           subtract ? FoldSub(il, size, n, operand)
+                    : FoldAdd(il, size, n, operand));
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  bool LiftADD(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    if (!instr.hasImmediate) {
+      return LiftAddSubRegister(instr, il, false);
+    }
+
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rd = GprOrSp(instr.size, instr.rd);
+    const RegisterOperand& Rn = GprOrSp(instr.size, instr.rn);
+
+    // Last instruction of ADRP+ADD, or of a MOVZ/MOVK chain: Rd = resolved constant
+    uint64_t base;
+    if (sequence.GetValue(instr.rn, base)) {
+      uint64_t value = (base + instr.imm) & Ones<uint64_t>(instr.size * 8);
+      bool pointer = instr.size == 8 && sequence.IsPointer(instr.rn);
+      il.AddInstruction(il.SetRegister(
+          Rd.size, Rd.id, SequenceConstant(il, Rd.size, value, pointer)));
+      sequence.SetValue(instr.rd, value, pointer);
+      return true;
+    }
+
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id,
+        il.Add(Rd.size, il.Register(Rn.size, Rn.id),
+               il.Const(Rd.size, instr.imm))));
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  bool LiftSUB(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    return LiftAddSubRegister(instr, il, true);
+  }
+
+  bool LiftLDR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rt = Gpr(instr.size, instr.rd);
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+
+    // Last instruction of ADRP+LDR: load from the resolved address
+    uint64_t base;
+    ExprId address;
+    bool resolved = sequence.GetValue(instr.rn, base);
+    if (resolved) {
+      address = il.ConstPointer(8, base + instr.imm);
+    } else if (instr.imm == 0) {
+      address = il.Register(Xn.size, Xn.id);
+    } else {
+      address = il.Add(8, il.Register(Xn.size, Xn.id), il.Const(8, instr.imm));
+    }
+
+    il.AddInstruction(
+        il.SetRegister(Rt.size, Rt.id, il.Load(Rt.size, address)));
+    if (resolved && Rt.size == 8) {
+      sequence.SetLoadAddress(instr.rd, base + instr.imm);
+    } else {
+      sequence.Clear(instr.rd);
+    }
+
+    return true;
+  }
+
+  bool LiftMOVZ(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+
+    il.AddInstruction(
+        il.SetRegister(Rd.size, Rd.id, il.Const(Rd.size, instr.imm)));
+    sequence.SetValue(instr.rd, instr.imm);
+
+    return true;
+  }
+
+  bool LiftMOVN(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+    uint64_t value = ~instr.imm & Ones<uint64_t>(instr.size * 8);
+
+    il.AddInstruction(il.SetRegister(Rd.size, Rd.id, il.Const(Rd.size, value)));
+    sequence.SetValue(instr.rd, value);
+
+    return true;
+  }
+
+  bool LiftMOVK(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Rd = Gpr(instr.size, instr.rd);
+    uint64_t mask = Ones<uint64_t>(instr.width) << instr.lsb;
+
+    // Part of a MOVZ/MOVK chain: Rd = resolved constant
+    uint64_t value;
+    if (sequence.GetValue(instr.rd, value)) {
+      value = ((value & ~mask) | instr.imm) & Ones<uint64_t>(instr.size * 8);
+      il.AddInstruction(
+          il.SetRegister(Rd.size, Rd.id, il.Const(Rd.size, value)));
+      sequence.SetValue(instr.rd, value);
+      return true;
+    }
+
+    // Rd = (Rd & ~mask) | imm
+    il.AddInstruction(il.SetRegister(
+        Rd.size, Rd.id,
+        il.Or(Rd.size,
+              il.And(Rd.size, il.Register(Rd.size, Rd.id),
+                     il.Const(Rd.size, ~mask)),
+              il.Const(Rd.size, instr.imm))));
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  /**
+   * Intrinsic of an LSE atomic, for the access size in bytes
+   */
+  static uint32_t GetAtomicIntrinsic(aarch64::Opcode atomic, size_t size) {
+    uint32_t family = static_cast<uint32_t>(atomic) -
+                      static_cast<uint32_t>(aarch64::Opcode::LDADD);
+    return kIntrinsicBase +
+           static_cast<uint32_t>(aarch64::OffsetIntrinsic(
+               aarch64::Intrinsic::LdAddB,
+               family * 4 + aarch64::GetAccessSizeIndex(size)));
+  }
+
+  /**
+   * Emit an atomic, the value memory held before is written to register rt unless it is the zero register
+   */
+  void AddAtomic(LowLevelILFunction& il, aarch64::Opcode atomic, size_t size,
+                 uint8_t rt, const std::vector<ExprId>& params) const {
+    std::vector<RegisterOrFlag> outputs;
+    if (rt != 31) {
+      const RegisterOperand& Rt = Gpr(size == 8 ? 8 : 4, rt);
+      outputs.push_back(RegisterOrFlag::Register(Rt.id));
+    }
+
+    il.AddInstruction(
+        il.Intrinsic(outputs, GetAtomicIntrinsic(atomic, size), params));
+  }
+
+  // LDADD, LDCLR, LDEOR, LDSET and SWP
+  bool LiftAtomic(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    size_t size = instr.size == 8 ? 8 : 4;
+
+    // Rt = atomic(Xn, Rs, order)
+    AddAtomic(il, instr.opcode, instr.size, instr.rd,
+              {il.Register(Xn.size, Xn.id),
+               Emit(il, size, ReadGpr(size, instr.rm)),
+               il.Const(1, instr.order)});
+    sequence.Clear(instr.rd);
+    sequence.ClearLoads();
+
+    return true;
+  }
+
+  bool LiftCAS(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    size_t size = instr.size == 8 ? 8 : 4;
+
+    // Rs = cas(Xn, Rs, Rt, order)
+    AddAtomic(il, instr.opcode, instr.size, instr.rm,
+              {il.Register(Xn.size, Xn.id),
+               Emit(il, size, ReadGpr(size, instr.rm)),
+               Emit(il, size, ReadGpr(size, instr.rd)),
+               il.Const(1, instr.order)});
+    sequence.Clear(instr.rm);
+    sequence.ClearLoads();
+
+    return true;
+  }
+
+  /**
+   * Collapse an exclusive loop into the atomic it implements, lifted at the exclusive load:
+   *
+   *   loop: ldxr  Rt, [Xn]
+   *         op    Rd, Rt, operand
+   *         stxr  Ws, Rd, [Xn]
+   *         cbnz  Ws, loop
+   *
+   * The load becomes Rt = atomic(Xn, operand, order), which also performs the store. The operation is lifted as is
+   * and computes Rd from the value loaded, the store is lifted as Ws = 0, and the branch back folds away once the
+   * status is known to be 0
+   *
+   * @return false for an exclusive load that does not start such a loop, which the base lifter lifts
+   */
+  bool LiftLDXR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    ThreadState& state = GetThreadState();
+    uint64_t addr = il.GetCurrentAddress();
+    // The operation, the store-exclusive and the branch back
+    uint32_t loop[3];
+    if (instr.rd == 31 || instr.rd == instr.rn || !ReadFollowing(il, loop, 3)) {
+      return false;
+    }
+
+    aarch64::ExclusiveOperation op;
+    aarch64::Instruction store;
+    uint32_t branch = loop[2];
+    if (!aarch64::DecodeExclusiveOperation(loop[0], op) ||
+        !aarch64::Decode(loop[1], store) ||
+        store.opcode != aarch64::Opcode::STXR) {
+      return false;
+    }
+
+    // The loaded value may be either operand of the commutative operations
+    if (!op.hasImmediate && !op.negate && op.atomic != aarch64::Opcode::SWP &&
+        op.rm == instr.rd) {
+      std::swap(op.rn, op.rm);
+    }
+
+    uint8_t status = store.rm;
+    bool operandIsRegister = !op.hasImmediate;
+    if (op.size != (instr.size == 8 ? 8 : 4) || store.size != instr.size ||
+        store.rn != instr.rn || store.rd != op.rd || op.rd == instr.rn ||
+        op.rn != (op.atomic == aarch64::Opcode::SWP ? 31 : instr.rd) ||
+        (operandIsRegister &&
+         (op.rm == instr.rd || op.rm == op.rd || op.rm == status)) ||
+        status == 31 || status == instr.rd || status == instr.rn ||
+        status == op.rd) {
+      return false;
+    }
+
+    // CBNZ Ws back to the exclusive load
+    if (branch != (0x35000000 | (0x7FFFD << 5) | status)) {
+      return false;
+    }
+
+    // Nothing else may enter the loop past the exclusive load
+    for (uint64_t next = addr + 4; next <= addr + 12; next += 4) {
+      if (il.GetLabelForAddress(this, next) != nullptr) {
+        return false;
+      }
+    }
+
+    size_t size = op.size;
+    ExprId operand;
+    if (op.hasImmediate) {
+      operand = il.Const(size, op.imm);
+    } else if (op.negate) {
+      operand = il.Neg(size, Emit(il, size, ReadGpr(size, op.rm)));
+    } else if (op.atomic == aarch64::Opcode::LDCLR) {
+      // AND keeps the bits set in the operand, LDCLR clears them
+      operand = il.Not(size, Emit(il, size, ReadGpr(size, op.rm)));
+    } else {
+      operand = Emit(il, size, ReadGpr(size, op.rm));
+    }
+
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    AddAtomic(il, op.atomic, instr.size, instr.rd,
+              {il.Register(Xn.size, Xn.id), operand,
+               il.Const(1, instr.order | store.order)});
+    state.sequence.Clear(instr.rd);
+    state.sequence.ClearLoads();
+    state.sequence.SetElidedStore(addr + 8, loop[1]);
+
+    return true;
+  }
+
+  /**
+   * Store-exclusive of a loop collapsed at its exclusive load: the store already happened and always succeeds
+   *
+   * @return false for any other store-exclusive, which the base lifter lifts
+   */
+  bool LiftSTXR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    ThreadState& state = GetThreadState();
+    aarch64::SequenceTracker& sequence = state.sequence;
+    if (!sequence.TakeElidedStore(il.GetCurrentAddress(), state.word)) {
+      return false;
+    }
+
+    SetGpr(il, 4, instr.rm, Constant(0));
+    sequence.SetValue(instr.rm, 0);
+    sequence.ClearLoads();
+
+    return true;
+  }
+
+  // CRC32 and CRC32C of every data size: Wd = crc(Wn, data)
+  bool LiftCRC32(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    // A checksum into the zero register has no effect at all
+    if (instr.rd == 31) {
+      il.AddInstruction(il.Nop());
+      return true;
+    }
+
+    uint32_t index = static_cast<uint32_t>(instr.opcode) -
+                     static_cast<uint32_t>(aarch64::Opcode::CRC32B);
+    // B, H, W or X data of each polynomial
+    size_t dataSize = static_cast<size_t>(1) << (index % 4);
+
+    ExprId data;
+    if (dataSize == 8) {
+      data = Emit(il, 8, ReadGpr(8, instr.rm));
+    } else if (dataSize == 4) {
+      data = Emit(il, 4, ReadGpr(4, instr.rm));
+    } else {
+      data = il.LowPart(dataSize, Emit(il, 4, ReadGpr(4, instr.rm)));
+    }
+
+    AddIntrinsic(il, Gpr(4, instr.rd).id,
+                 aarch64::OffsetIntrinsic(aarch64::Intrinsic::Crc32B, index),
+                 {Emit(il, 4, ReadGpr(4, instr.rn)), data});
+    GetThreadState().sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  /**
+   * Modifier of a pointer authentication instruction, register number 31 is the stack pointer
+   */
+  ExprId PointerModifier(LowLevelILFunction& il,
+                         const aarch64::Instruction& instr,
+                         uint8_t number) const {
+    if (instr.hasImmediate) {
+      return il.Const(8, 0);
+    }
+
+    const RegisterOperand& modifier = BaseRegister(number);
+    return il.Register(modifier.size, modifier.id);
+  }
+
+  // PACIA to XPACD and their hint forms: Xd = pac(Xd, modifier), or Xd left as is when lifted as no-ops
+  bool LiftPointerAuth(const aarch64::Instruction& instr,
+                       LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    if (mPointerAuthNop || instr.rd == 31) {
+      il.AddInstruction(il.Nop());
+      // The pointer keeps its value, and a resolved address stays resolved
+      uint64_t value;
+      if (sequence.GetValue(instr.rd, value)) {
+        sequence.SetValue(instr.rd, value, sequence.IsPointer(instr.rd));
+      } else {
+        sequence.Clear(instr.rd);
+      }
+      return true;
+    }
+
+    const RegisterOperand& Xd = Gpr(8, instr.rd);
+    std::vector<ExprId> params = {il.Register(8, Xd.id)};
+    if (instr.opcode < aarch64::Opcode::XPACI) {
+      params.push_back(PointerModifier(il, instr, instr.rn));
+    }
+
+    uint32_t index = static_cast<uint32_t>(instr.opcode) -
+                     static_cast<uint32_t>(aarch64::Opcode::PACIA);
+    AddIntrinsic(il, Xd.id,
+                 aarch64::OffsetIntrinsic(aarch64::Intrinsic::Pacia, index),
+                 params);
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  /**
+   * Returns true if the flags of the comparison being lifted are only read by the conditional select right after it,
+   * which compares its operands directly, and are then overwritten by another comparison
+   */
+  bool CanElideFlags(LowLevelILFunction& il) {
+    // The conditional select and the next comparison
+    uint32_t words[2];
+    uint64_t addr = il.GetCurrentAddress();
+    if (!mElideFlagWrites || !ReadFollowing(il, words, 2) ||
+        il.GetLabelForAddress(this, addr + 4) != nullptr ||
+        il.GetLabelForAddress(this, addr + 8) != nullptr) {
+      return false;
+    }
+
+    aarch64::Instruction consumer;
+    aarch64::Instruction next;
+    return aarch64::Decode(words[0], consumer, mEncodingClasses,
+                           mEncodingClassCount) &&
+           aarch64::IsConditionalSelectOpcode(consumer.opcode) &&
+           mLifters[0][static_cast<size_t>(consumer.opcode)] != nullptr &&
+           IsRelation(consumer.cond) && aarch64::Decode(words[1], next) &&
+           (next.opcode == aarch64::Opcode::SUBS ||
+            next.opcode == aarch64::Opcode::CMP);
+  }
+
+  /**
+   * Operands of SUBS and CMP, and of CCMP and CCMN once their shift is cleared
+   */
+  static aarch64::SequenceTracker::Comparison
+  ComparisonOf(const aarch64::Instruction& instr) {
+    return {instr.size, instr.rn, instr.hasImmediate, instr.imm, instr.rm,
+            instr.imms};
+  }
+
+  /**
+   * SUBS and CMP. The comparison is recorded for the instruction right after it, which compares the operands directly
+   * if it reads the flags. The flags are still set for any later reader, see CanElideFlags
+   */
+  bool LiftSUBS(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    size_t size = instr.size;
+    aarch64::SequenceTracker::Comparison comparison = ComparisonOf(instr);
+    // A destination overwriting an operand leaves nothing to compare afterwards, and the flags are then kept for the
+    // conditional select to read
+    bool recorded = instr.rd == 31 ||
+                    (instr.rd != instr.rn &&
+                     (instr.hasImmediate || instr.rd != instr.rm));
+    bool elide = recorded && CanElideFlags(il);
+
+    if (instr.rd == 31 && elide) {
+      il.AddInstruction(il.Nop());
+    } else {
+      ExprId difference =
+          il.Sub(size, ComparisonRegister(il, comparison),
+                 ComparisonOperand(il, comparison), elide ? 0 : mFlagWriteAll);
+      if (instr.rd != 31) {
+        difference = il.SetRegister(size, Gpr(size, instr.rd).id, difference);
+      }
+      il.AddInstruction(difference);
+    }
+
+    if (recorded) {
+      sequence.SetComparison(comparison);
+    }
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  /**
+   * CCMP and CCMN: the flags of the comparison if the condition holds, else the NZCV value of the instruction
+   */
+  bool LiftCCMP(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    size_t size = instr.size;
+    // imms is the NZCV value
+    aarch64::SequenceTracker::Comparison comparison = ComparisonOf(instr);
+    comparison.shift = 0;
+    auto compare = [&] {
+      // Register number 31 is the zero register in both forms
+      ExprId Rn = Emit(il, size, ReadGpr(size, instr.rn));
+      ExprId operand = ComparisonOperand(il, comparison);
+      il.AddInstruction(instr.opcode == aarch64::Opcode::CCMP
+                            ? il.Sub(size, Rn, operand, mFlagWriteAll)
+                            : il.Add(size, Rn, operand, mFlagWriteAll));
+    };
+
+    if (instr.cond == aarch64::Condition::AL ||
+        instr.cond == aarch64::Condition::NV) {
+      compare();
+      return true;
+    }
+
+    LowLevelILLabel trueLabel, falseLabel, afterLabel;
+    il.AddInstruction(
+        il.If(ConditionExpression(il, instr.cond), trueLabel, falseLabel));
+
+    il.MarkLabel(trueLabel);
+    compare();
+    il.AddInstruction(il.Goto(afterLabel));
+
+    il.MarkLabel(falseLabel);
+    il.AddInstruction(
+        il.SetFlag(mNegativeFlag, il.Const(0, instr.imms >> 3 & 1)));
+    il.AddInstruction(il.SetFlag(mZeroFlag, il.Const(0, instr.imms >> 2 & 1)));
+    il.AddInstruction(
+        il.SetFlag(mCarryFlag, il.Const(0, instr.imms >> 1 & 1)));
+    il.AddInstruction(il.SetFlag(mOverflowFlag, il.Const(0, instr.imms & 1)));
+
+    il.MarkLabel(afterLabel);
+
+    return true;
+  }
+
+  bool LiftBCOND(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    uint64_t taken = il.GetCurrentAddress() + instr.imm;
+    uint64_t next = il.GetCurrentAddress() + 4;
+    BNLowLevelILLabel* takenLabel = il.GetLabelForAddress(this, taken);
+    BNLowLevelILLabel* nextLabel = il.GetLabelForAddress(this, next);
+
+    // A target outside the blocks of the function is jumped to
+    LowLevelILLabel takenCode, nextCode;
+    il.AddInstruction(il.If(ConditionExpression(il, instr.cond),
+                            takenLabel != nullptr ? *takenLabel : takenCode,
+                            nextLabel != nullptr ? *nextLabel : nextCode));
+    if (takenLabel == nullptr) {
+      il.MarkLabel(takenCode);
+      il.AddInstruction(il.Jump(il.ConstPointer(8, taken)));
+    }
+    if (nextLabel == nullptr) {
+      il.MarkLabel(nextCode);
+      il.AddInstruction(il.Jump(il.ConstPointer(8, next)));
+    }
+
+    return true;
+  }
+
+  /**
+   * Target of a branch to a register. The register of an import stub or a veneer, ADRP+LDR(+ADD)+BR on X16 or X17,
+   * was loaded from its GOT slot in the same block, and the branch is then to the doubleword of the slot: the core
+   * resolves the import right away, without dataflow through the register for the stub and again for every caller
+   */
+  ExprId BranchTarget(LowLevelILFunction& il, uint8_t number) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    uint64_t slot;
+    if (sequence.GetLoadAddress(number, slot)) {
+      return il.Load(8, il.ConstPointer(8, slot));
+    }
+
+    return il.Register(8, Gpr(8, number).id);
+  }
+
+  bool LiftBR(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    il.AddInstruction(il.Jump(BranchTarget(il, instr.rn)));
+
+    return true;
+  }
+
+  // RETAA to BLRAB: a return, a branch or a call to the register, the authentication leaves no trace in the IL
+  bool LiftAuthenticatedBranch(const aarch64::Instruction& instr,
+                               LowLevelILFunction& il) {
+    // The stubs of arm64e load X16 from the slot X17 holds the address of and branch with BRAA X16, X17
+    ExprId target = BranchTarget(il, instr.rn);
+    switch (instr.opcode) {
+    case aarch64::Opcode::RETAA:
+    case aarch64::Opcode::RETAB:
+      il.AddInstruction(il.Return(target));
+      break;
+    case aarch64::Opcode::BRAA:
+    case aarch64::Opcode::BRAB:
+      il.AddInstruction(il.Jump(target));
+      break;
+    default:
+      il.AddInstruction(il.Call(target));
+      break;
+    }
+
+    return true;
+  }
+
+  ExprId ScalableRegister(LowLevelILFunction& il, unsigned int number) {
+    const RegisterOperand& Zn = Zr(number);
+    return il.Register(Zn.size, Zn.id);
+  }
+
+  ExprId PredicateRegister(LowLevelILFunction& il, unsigned int number) {
+    const RegisterOperand& Pn = Pr(number);
+    return il.Register(Pn.size, Pn.id);
+  }
+
+  /**
+   * Emit an intrinsic of the scalable vector extension, the element size is appended to params
+   *
+   * @param outputs register written, none for the stores
+   */
+  static void AddScalableIntrinsic(LowLevelILFunction& il,
+                                   const std::vector<RegisterOrFlag>& outputs,
+                                   aarch64::Intrinsic intrinsic,
+                                   std::vector<ExprId> params,
+                                   uint8_t esize) {
+    params.push_back(il.Const(1, esize));
+    il.AddInstruction(il.Intrinsic(
+        outputs, kIntrinsicBase + static_cast<uint32_t>(intrinsic), params));
+  }
+
+  /**
+   * Number of elements of esize bytes selected by a pattern, to a temporary register
+   */
+  static ExprId ElementCount(LowLevelILFunction& il, uint8_t pattern,
+                             uint8_t esize) {
+    AddScalableIntrinsic(il, {RegisterOrFlag::Register(LLIL_TEMP(0))},
+                         aarch64::Intrinsic::SveCnt,
+                         {il.Const(1, pattern)}, esize);
+    return il.Register(8, LLIL_TEMP(0));
+  }
+
+  /**
+   * Set the flags as PTEST of the predicate result pd under the governing predicate pg: N if the first active element
+   * is set, Z if none is, C if the last active element is clear, and V clear
+   */
+  void SetPredicateTestFlags(LowLevelILFunction& il, uint8_t pg, uint8_t pd) {
+    il.AddInstruction(il.Intrinsic(
+        {RegisterOrFlag::Flag(mNegativeFlag)},
+        kIntrinsicBase +
+            static_cast<uint32_t>(aarch64::Intrinsic::SvePtestFirst),
+        {PredicateRegister(il, pg), PredicateRegister(il, pd)}));
+    // Inactive elements of the result are zeroed
+    const RegisterOperand& Pd = Pr(pd);
+    il.AddInstruction(il.SetFlag(
+        mZeroFlag, il.CompareEqual(Pd.size, il.Register(Pd.size, Pd.id),
+                                   il.Const(Pd.size, 0))));
+    il.AddInstruction(il.Intrinsic(
+        {RegisterOrFlag::Flag(mCarryFlag)},
+        kIntrinsicBase +
+            static_cast<uint32_t>(aarch64::Intrinsic::SvePtestNlast),
+        {PredicateRegister(il, pg), PredicateRegister(il, pd)}));
+    il.AddInstruction(il.SetFlag(mOverflowFlag, il.Const(0, 0)));
+  }
+
+  bool LiftPTRUE(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddScalableIntrinsic(il, {RegisterOrFlag::Register(Pr(instr.rd).id)},
+                         aarch64::Intrinsic::SvePtrue,
+                         {il.Const(1, instr.pattern)}, instr.esize);
+
+    return true;
+  }
+
+  /**
+   * Operand of WHILELT to WHILELS, extended to 64 bits as the comparison does
+   */
+  ExprId WhileOperand(const aarch64::Instruction& instr, LowLevelILFunction& il,
+                      uint8_t number) {
+    const RegisterOperand& Rn = Gpr(instr.size, number);
+    ExprId value = il.Register(Rn.size, Rn.id);
+    if (instr.size == 8) {
+      return value;
+    }
+
+    bool isSigned = instr.opcode == aarch64::Opcode::WHILELT ||
+                    instr.opcode == aarch64::Opcode::WHILELE;
+    return isSigned ? il.SignExtend(8, value) : il.ZeroExtend(8, value);
+  }
+
+  // WHILELT, WHILELE, WHILELO and WHILELS: Pd = elements i with Rn + i < Rm (or <=), the flags as PTEST of Pd
+  //
+  // The flags are computed from the operands rather than from Pd: the first element is active if and only if Rn < Rm,
+  // so that the conditional branch closing the loop lifts as a comparison of the induction variable with its bound
+  bool LiftWHILE(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    AddScalableIntrinsic(
+        il, {RegisterOrFlag::Register(Pr(instr.rd).id)},
+        aarch64::OffsetIntrinsic(
+            aarch64::Intrinsic::SveWhileLt,
+            static_cast<uint32_t>(instr.opcode) -
+                static_cast<uint32_t>(aarch64::Opcode::WHILELT)),
+        {WhileOperand(instr, il, instr.rn), WhileOperand(instr, il, instr.rm)},
+        instr.esize);
+
+    // Rn < Rm, or Rn <= Rm, or the opposite
+    auto first = [&](bool active) {
+      ExprId a = WhileOperand(instr, il, instr.rn);
+      ExprId b = WhileOperand(instr, il, instr.rm);
+      switch (instr.opcode) {
+      case aarch64::Opcode::WHILELT:
+        return active ? il.CompareSignedLessThan(8, a, b)
+                      : il.CompareSignedGreaterEqual(8, a, b);
+      case aarch64::Opcode::WHILELE:
+        return active ? il.CompareSignedLessEqual(8, a, b)
+                      : il.CompareSignedGreaterThan(8, a, b);
+      case aarch64::Opcode::WHILELO:
+        return active ? il.CompareUnsignedLessThan(8, a, b)
+                      : il.CompareUnsignedGreaterEqual(8, a, b);
+      default:
+        return active ? il.CompareUnsignedLessEqual(8, a, b)
+                      : il.CompareUnsignedGreaterThan(8, a, b);
+      }
+    };
+
+    // The last element is inactive unless the first one is active and Rm - Rn covers all the elements, one less for
+    // WHILELE and WHILELS
+    ExprId count = ElementCount(il, aarch64::kPatternAll, instr.esize);
+    if (instr.opcode == aarch64::Opcode::WHILELE ||
+        instr.opcode == aarch64::Opcode::WHILELS) {
+      count = il.Sub(8, count, il.Const(8, 1));
+    }
+    ExprId lastInactive = il.Or(
+        0, first(false),
+        il.CompareUnsignedLessThan(8,
+                                   il.Sub(8, WhileOperand(instr, il, instr.rm),
+                                          WhileOperand(instr, il, instr.rn)),
+                                   count));
+
+    il.AddInstruction(il.SetFlag(mNegativeFlag, first(true)));
+    il.AddInstruction(il.SetFlag(mZeroFlag, first(false)));
+    il.AddInstruction(il.SetFlag(mCarryFlag, lastInactive));
+    il.AddInstruction(il.SetFlag(mOverflowFlag, il.Const(0, 0)));
+
+    return true;
+  }
+
+  // CNTB to CNTD: Xd = count * imm, INCB to INCD and DECB to DECD: Xdn = Xdn +/- count * imm
+  bool LiftElementCount(const aarch64::Instruction& instr,
+                        LowLevelILFunction& il) {
+    aarch64::SequenceTracker& sequence = GetThreadState().sequence;
+    ExprId value = ElementCount(il, instr.pattern, instr.esize);
+    if (instr.imm != 1) {
+      value = il.Mult(8, value, il.Const(8, instr.imm));
+    }
+
+    const RegisterOperand& Xdn = Gpr(8, instr.rd);
+    if (instr.opcode >= aarch64::Opcode::DECB) {
+      value = il.Sub(8, il.Register(8, Xdn.id), value);
+    } else if (instr.opcode >= aarch64::Opcode::INCB) {
+      value = il.Add(8, il.Register(8, Xdn.id), value);
+    }
+
+    SetGpr(il, 8, instr.rd, Expression(value));
+    sequence.Clear(instr.rd);
+
+    return true;
+  }
+
+  /**
+   * Address of LD1B to ST1D: Xn plus Xm scaled by the element size, or plus imm vector lengths
+   */
+  ExprId ScalableAddress(const aarch64::Instruction& instr,
+                         LowLevelILFunction& il) {
+    const RegisterOperand& Xn = BaseRegister(instr.rn);
+    ExprId base = il.Register(Xn.size, Xn.id);
+    if (instr.hasImmediate) {
+      if (instr.imm == 0) {
+        return base;
+      }
+
+      // Bytes per vector
+      ExprId length = ElementCount(il, aarch64::kPatternAll, 1);
+      return il.Add(8, base,
+                    il.Mult(8, length, il.Const(8, instr.imm)));
+    }
+
+    const RegisterOperand& Xm = Gpr(8, instr.rm);
+    ExprId index = il.Register(Xm.size, Xm.id);
+    if (instr.esize != 1) {
+      // 1, 2, 4 and 8 byte elements, shifted by 0 to 3
+      unsigned int shift = instr.esize == 8 ? 3 : instr.esize / 2;
+      index = il.ShiftLeft(8, index, il.Const(1, shift));
+    }
+    return il.Add(8, base, index);
+  }
+
+  // LD1B to LD1D: Zt = elements of Pg loaded from the address, the others zeroed
+  bool LiftScalableLoad(const aarch64::Instruction& instr,
+                        LowLevelILFunction& il) {
+    ExprId address = ScalableAddress(instr, il);
+    AddScalableIntrinsic(il, {RegisterOrFlag::Register(Zr(instr.rd).id)},
+                         aarch64::Intrinsic::SveLd1,
+                         {PredicateRegister(il, instr.ra), address},
+                         instr.esize);
+
+    return true;
+  }
+
+  // ST1B to ST1D: elements of Pg of Zt stored to the address
+  bool LiftScalableStore(const aarch64::Instruction& instr,
+                         LowLevelILFunction& il) {
+    ExprId address = ScalableAddress(instr, il);
+    AddScalableIntrinsic(il, {}, aarch64::Intrinsic::SveSt1,
+                         {ScalableRegister(il, instr.rd),
+                          PredicateRegister(il, instr.ra), address},
+                         instr.esize);
+    GetThreadState().sequence.ClearLoads();
+
+    return true;
+  }
+
+  // ADD and SUB: Zd = Zn op Zm, and the predicated forms: Zdn = Zdn op Zm in the elements of Pg
+  bool LiftScalableArithmetic(const aarch64::Instruction& instr,
+                              LowLevelILFunction& il) {
+    std::vector<ExprId> params;
+    if (instr.opcode >= aarch64::Opcode::ZADDM) {
+      params.push_back(PredicateRegister(il, instr.ra));
+    }
+    params.push_back(ScalableRegister(il, instr.rn));
+    params.push_back(ScalableRegister(il, instr.rm));
+
+    AddScalableIntrinsic(
+        il, {RegisterOrFlag::Register(Zr(instr.rd).id)},
+        aarch64::OffsetIntrinsic(
+            aarch64::Intrinsic::SveAdd,
+            static_cast<uint32_t>(instr.opcode) -
+                static_cast<uint32_t>(aarch64::Opcode::ZADD)),
+        params, instr.esize);
+
+    return true;
+  }
+
+  // CMPEQ to CMPLE: Pd = elements of Pg where Zn cond Zm (or imm), the others zeroed, and the flags as PTEST of Pd
+  bool LiftScalableCompare(const aarch64::Instruction& instr,
+                           LowLevelILFunction& il) {
+    uint32_t index = static_cast<uint32_t>(instr.opcode) -
+                     static_cast<uint32_t>(aarch64::Opcode::CMPEQ);
+    aarch64::Intrinsic intrinsic;
+    ExprId operand;
+    if (instr.hasImmediate) {
+      // CMPHS and CMPHI have no signed immediate form
+      intrinsic = aarch64::OffsetIntrinsic(aarch64::Intrinsic::SveCmpEqImm,
+                                           index < 4 ? index : index - 2);
+      operand = il.Const(8, instr.imm);
+    } else {
+      intrinsic =
+          aarch64::OffsetIntrinsic(aarch64::Intrinsic::SveCmpEq, index);
+      operand = ScalableRegister(il, instr.rm);
+    }
+
+    AddScalableIntrinsic(il, {RegisterOrFlag::Register(Pr(instr.rd).id)},
+                         intrinsic,
+                         {PredicateRegister(il, instr.ra),
+                          ScalableRegister(il, instr.rn), operand},
+                         instr.esize);
+    SetPredicateTestFlags(il, instr.ra, instr.rd);
+
+    return true;
+  }
+
+  /**
+   * Registry of all the lifters, indexed into mLifters by LoadSettings. A new lifter only needs an entry here, along
+   * with the encoding class of its instruction in aarch64::kEncodingClasses
+   */
+  static const LifterRegistration* GetLifterRegistry(size_t& count) {
+    using aarch64::Opcode;
+    typedef AArch64ArchitectureExtension Self;
+
+    static const LifterRegistration registry[] = {
+        {Opcode::CSEL, Opcode::CSEL, &Self::LiftCSEL},
+        {Opcode::CSINC, Opcode::CSINC, &Self::LiftCSINC},
+        {Opcode::CINC, Opcode::CSINC, &Self::LiftCINC},
+        {Opcode::CSET, Opcode::CSINC, &Self::LiftCSET},
+        {Opcode::CSINV, Opcode::CSINV, &Self::LiftCSINV},
+        {Opcode::CINV, Opcode::CSINV, &Self::LiftCINV},
+        {Opcode::CSETM, Opcode::CSINV, &Self::LiftCSETM},
+        {Opcode::CSNEG, Opcode::CSNEG, &Self::LiftCSNEG},
+        {Opcode::CNEG, Opcode::CSNEG, &Self::LiftCNEG},
+        {Opcode::MADD, Opcode::MADD, &Self::LiftMADD},
+        {Opcode::MUL, Opcode::MADD, &Self::LiftMUL},
+        {Opcode::MSUB, Opcode::MSUB, &Self::LiftMSUB},
+        {Opcode::MNEG, Opcode::MSUB, &Self::LiftMNEG},
+        {Opcode::SMADDL, Opcode::SMADDL, &Self::LiftSMADDL},
+        {Opcode::SMULL, Opcode::SMADDL, &Self::LiftSMULL},
+        {Opcode::SMSUBL, Opcode::SMSUBL, &Self::LiftSMSUBL},
+        {Opcode::SMNEGL, Opcode::SMSUBL, &Self::LiftSMNEGL},
+        {Opcode::UMADDL, Opcode::UMADDL, &Self::LiftUMADDL},
+        {Opcode::UMULL, Opcode::UMADDL, &Self::LiftUMULL},
+        {Opcode::UMSUBL, Opcode::UMSUBL, &Self::LiftUMSUBL},
+        {Opcode::UMNEGL, Opcode::UMSUBL, &Self::LiftUMNEGL},
+        {Opcode::SMULH, Opcode::SMULH, &Self::LiftSMULH},
+        {Opcode::UMULH, Opcode::UMULH, &Self::LiftUMULH},
+        {Opcode::LSR, Opcode::UBFM, &Self::LiftLSR<4>, &Self::LiftLSR<8>},
+        {Opcode::BFI, Opcode::BFM, &Self::LiftBFI<4>, &Self::LiftBFI<8>},
+        {Opcode::BFXIL, Opcode::BFM, &Self::LiftBFXIL<4>, &Self::LiftBFXIL<8>},
+        {Opcode::LSL, Opcode::UBFM, &Self::LiftLSL<4>, &Self::LiftLSL<8>},
+        {Opcode::UBFIZ, Opcode::UBFM, &Self::LiftUBFIZ<4>, &Self::LiftUBFIZ<8>},
+        {Opcode::UBFX, Opcode::UBFM, &Self::LiftUBFX<4>, &Self::LiftUBFX<8>},
+        {Opcode::UXTB, Opcode::UBFM, &Self::LiftUBFX<4>, &Self::LiftUBFX<8>},
+        {Opcode::UXTH, Opcode::UBFM, &Self::LiftUBFX<4>, &Self::LiftUBFX<8>},
+        {Opcode::ASR, Opcode::SBFM, &Self::LiftASR<4>, &Self::LiftASR<8>},
+        {Opcode::SBFIZ, Opcode::SBFM, &Self::LiftSBFIZ<4>, &Self::LiftSBFIZ<8>},
+        {Opcode::SBFX, Opcode::SBFM, &Self::LiftSBFX<4>, &Self::LiftSBFX<8>},
+        {Opcode::SXTB, Opcode::SBFM, &Self::LiftSBFX<4>, &Self::LiftSBFX<8>},
+        {Opcode::SXTH, Opcode::SBFM, &Self::LiftSBFX<4>, &Self::LiftSBFX<8>},
+        {Opcode::SXTW, Opcode::SBFM, &Self::LiftSBFX<4>, &Self::LiftSBFX<8>},
+        {Opcode::EXTR, Opcode::EXTR, &Self::LiftEXTR<4>, &Self::LiftEXTR<8>},
+        {Opcode::ROR, Opcode::EXTR, &Self::LiftROR<4>, &Self::LiftROR<8>},
+        {Opcode::ROR, Opcode::RORV, &Self::LiftROR<4>, &Self::LiftROR<8>},
+        {Opcode::ADRP, Opcode::ADRP, &Self::LiftADRP},
+        {Opcode::ADD, Opcode::ADD, &Self::LiftADD},
+        {Opcode::SUB, Opcode::SUB, &Self::LiftSUB},
+        {Opcode::LDR, Opcode::LDR, &Self::LiftLDR},
+        {Opcode::MOVZ, Opcode::MOVZ, &Self::LiftMOVZ},
+        {Opcode::MOVN, Opcode::MOVN, &Self::LiftMOVN},
+        {Opcode::MOVK, Opcode::MOVK, &Self::LiftMOVK},
+        {Opcode::LDADD, Opcode::LDADD, &Self::LiftAtomic},
+        {Opcode::LDCLR, Opcode::LDADD, &Self::LiftAtomic},
+        {Opcode::LDEOR, Opcode::LDADD, &Self::LiftAtomic},
+        {Opcode::LDSET, Opcode::LDADD, &Self::LiftAtomic},
+        {Opcode::SWP, Opcode::SWP, &Self::LiftAtomic},
+        {Opcode::CAS, Opcode::CAS, &Self::LiftCAS},
+        {Opcode::LDXR, Opcode::LDXR, &Self::LiftLDXR},
+        {Opcode::STXR, Opcode::STXR, &Self::LiftSTXR},
+        {Opcode::CRC32B, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32H, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32W, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32X, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32CB, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32CH, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32CW, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::CRC32CX, Opcode::CRC32B, &Self::LiftCRC32},
+        {Opcode::BR, Opcode::BR, &Self::LiftBR},
+        {Opcode::SUBS, Opcode::SUBS, &Self::LiftSUBS},
+        {Opcode::CMP, Opcode::SUBS, &Self::LiftSUBS},
+        {Opcode::CCMP, Opcode::CCMN, &Self::LiftCCMP},
+        {Opcode::CCMN, Opcode::CCMN, &Self::LiftCCMP},
+        {Opcode::BCOND, Opcode::BCOND, &Self::LiftBCOND},
+        {Opcode::PACIA, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::PACIB, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::PACDA, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::PACDB, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::AUTIA, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::AUTIB, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::AUTDA, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::AUTDB, Opcode::PACIA, &Self::LiftPointerAuth},
+        {Opcode::XPACI, Opcode::XPACI, &Self::LiftPointerAuth},
+        {Opcode::XPACD, Opcode::XPACI, &Self::LiftPointerAuth},
+        {Opcode::RETAA, Opcode::RETAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::RETAB, Opcode::RETAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::BRAA, Opcode::BRAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::BRAB, Opcode::BRAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::BLRAA, Opcode::BRAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::BLRAB, Opcode::BRAA, &Self::LiftAuthenticatedBranch},
+        {Opcode::VADD, Opcode::VADD, &Self::LiftVADD},
+        {Opcode::VSUB, Opcode::VSUB, &Self::LiftVSUB},
+        {Opcode::VAND, Opcode::VAND, &Self::LiftVAND},
+        {Opcode::VBIC, Opcode::VBIC, &Self::LiftVBIC},
+        {Opcode::VBIC, Opcode::MOVI, &Self::LiftVBIC},
+        {Opcode::VORR, Opcode::VORR, &Self::LiftVORR},
+        {Opcode::VORR, Opcode::MOVI, &Self::LiftVORR},
+        {Opcode::VMOV, Opcode::VORR, &Self::LiftVMOV},
+        {Opcode::VEOR, Opcode::VEOR, &Self::LiftVEOR},
+        {Opcode::DUP, Opcode::DUP, &Self::LiftDUP},
+        {Opcode::MOVI, Opcode::MOVI, &Self::LiftMOVI},
+        {Opcode::MVNI, Opcode::MOVI, &Self::LiftMVNI},
+        {Opcode::EXT, Opcode::EXT, &Self::LiftEXT},
+        {Opcode::TBL, Opcode::TBL, &Self::LiftTBL},
+        {Opcode::LD1, Opcode::LD1, &Self::LiftLD1},
+        {Opcode::ST1, Opcode::LD1, &Self::LiftST1},
+        {Opcode::AESE, Opcode::AESE, &Self::LiftCryptoBinary},
+        {Opcode::AESD, Opcode::AESE, &Self::LiftCryptoBinary},
+        {Opcode::AESMC, Opcode::AESE, &Self::LiftCryptoUnary},
+        {Opcode::AESIMC, Opcode::AESE, &Self::LiftCryptoUnary},
+        {Opcode::SHA1C, Opcode::SHA1C, &Self::LiftSHA1C},
+        {Opcode::SHA1P, Opcode::SHA1C, &Self::LiftSHA1C},
+        {Opcode::SHA1M, Opcode::SHA1C, &Self::LiftSHA1C},
+        {Opcode::SHA1SU0, Opcode::SHA1C, &Self::LiftCryptoTernary},
+        {Opcode::SHA256H, Opcode::SHA1C, &Self::LiftCryptoTernary},
+        {Opcode::SHA256H2, Opcode::SHA1C, &Self::LiftCryptoTernary},
+        {Opcode::SHA256SU1, Opcode::SHA1C, &Self::LiftCryptoTernary},
+        {Opcode::SHA1H, Opcode::SHA1H, &Self::LiftSHA1H},
+        {Opcode::SHA1SU1, Opcode::SHA1H, &Self::LiftCryptoBinary},
+        {Opcode::SHA256SU0, Opcode::SHA1H, &Self::LiftCryptoBinary},
+        {Opcode::SHA512H, Opcode::SHA512H, &Self::LiftCryptoTernary},
+        {Opcode::SHA512H2, Opcode::SHA512H, &Self::LiftCryptoTernary},
+        {Opcode::SHA512SU1, Opcode::SHA512H, &Self::LiftCryptoTernary},
+        {Opcode::SHA512SU0, Opcode::SHA512SU0, &Self::LiftCryptoBinary},
+        {Opcode::PMULL, Opcode::PMULL, &Self::LiftPMULL},
+        {Opcode::PMULL2, Opcode::PMULL, &Self::LiftPMULL},
+        {Opcode::PTRUE, Opcode::PTRUE, &Self::LiftPTRUE},
+        {Opcode::WHILELT, Opcode::WHILELT, &Self::LiftWHILE},
+        {Opcode::WHILELE, Opcode::WHILELT, &Self::LiftWHILE},
+        {Opcode::WHILELO, Opcode::WHILELT, &Self::LiftWHILE},
+        {Opcode::WHILELS, Opcode::WHILELT, &Self::LiftWHILE},
+        {Opcode::CNTB, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::CNTH, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::CNTW, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::CNTD, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::INCB, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::INCH, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::INCW, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::INCD, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::DECB, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::DECH, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::DECW, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::DECD, Opcode::CNTB, &Self::LiftElementCount},
+        {Opcode::LD1B, Opcode::LD1B, &Self::LiftScalableLoad},
+        {Opcode::LD1H, Opcode::LD1B, &Self::LiftScalableLoad},
+        {Opcode::LD1W, Opcode::LD1B, &Self::LiftScalableLoad},
+        {Opcode::LD1D, Opcode::LD1B, &Self::LiftScalableLoad},
+        {Opcode::ST1B, Opcode::ST1B, &Self::LiftScalableStore},
+        {Opcode::ST1H, Opcode::ST1B, &Self::LiftScalableStore},
+        {Opcode::ST1W, Opcode::ST1B, &Self::LiftScalableStore},
+        {Opcode::ST1D, Opcode::ST1B, &Self::LiftScalableStore},
+        {Opcode::ZADD, Opcode::ZADD, &Self::LiftScalableArithmetic},
+        {Opcode::ZSUB, Opcode::ZADD, &Self::LiftScalableArithmetic},
+        {Opcode::ZADDM, Opcode::ZADDM, &Self::LiftScalableArithmetic},
+        {Opcode::ZSUBM, Opcode::ZADDM, &Self::LiftScalableArithmetic},
+        // EQ to GT also have an immediate form, of the class of CMPLT
+        {Opcode::CMPEQ, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPNE, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPGE, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPGT, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPHS, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPHI, Opcode::CMPHS, &Self::LiftScalableCompare},
+        {Opcode::CMPLT, Opcode::CMPLT, &Self::LiftScalableCompare},
+        {Opcode::CMPLE, Opcode::CMPLT, &Self::LiftScalableCompare},
+    };
+
+    count = sizeof(registry) / sizeof(registry[0]);
+    return registry;
+  }
+
+  /**
+   * Lift a decoded instruction, IL is only emitted if the lifter accepts the operands
+   *
+   * @return false if the lifter rejected the operands
+   */
+  bool Lift(const aarch64::Instruction& instr, LowLevelILFunction& il) {
+    Lifter lift = mLifters[instr.size == 8][static_cast<size_t>(instr.opcode)];
+    return (this->*lift)(instr, il);
+  }
+
+  static aarch64::ThreadTrace& GetTrace(ThreadState& state) {
+    if (!state.trace) {
+      state.trace.reset(new aarch64::ThreadTrace());
+    }
+    return *state.trace;
+  }
+
+  /**
+   * Lift an instruction with the base architecture, counted as a fallback of opcode
+   */
+  bool LiftWithBase(const uint8_t* data, uint64_t addr, size_t& len,
+                    LowLevelILFunction& il, aarch64::Opcode opcode) {
+    ThreadState& state = GetThreadState();
+    state.statistics.Add(opcode, aarch64::kFallback);
+    state.liftOpcode = opcode;
+    state.liftFallback = true;
+    return ArchitectureHook::GetInstructionLowLevelIL(data, addr, len, il);
+  }
+
+  /**
+   * Lift an instruction with one of the lifters, or with the base architecture
+   */
+  bool LiftInstruction(const uint8_t* data, uint64_t addr, size_t& len,
+                       LowLevelILFunction& il) {
+    ThreadState& state = GetThreadState();
+    aarch64::ThreadStatistics& statistics = state.statistics;
+    // A clear bit is a decode that would match no encoding class, skipped along with the decode cache lookup
+    const aarch64::PrescanBitmap* prescan = mPrescan ? GetPrescan(il) : nullptr;
+    if (prescan != nullptr && !prescan->MayNeedLift(addr)) {
+      statistics.Add(aarch64::kPrescanSkips);
+      return LiftWithBase(data, addr, len, il, aarch64::Opcode::Invalid);
+    }
+
+    const aarch64::DecodeCacheEntry* entry = Decode(data, addr, len, &il);
+    if (entry == nullptr || entry->verdict != aarch64::Verdict::Supported) {
+      return LiftWithBase(data, addr, len, il,
+                          entry != nullptr ? entry->instr.opcode
+                                           : aarch64::Opcode::Invalid);
+    }
+
+    const aarch64::Instruction& instr = entry->instr;
+    statistics.Add(instr.opcode, aarch64::kAttempted);
+
+    state.following = data + 4;
+    state.followingLength = len - 4;
+    state.word = entry->word;
+
+    bool lifted;
+    if (mTimeLifters) {
+      uint64_t start = aarch64::ReadCycleCounter();
+      lifted = Lift(instr, il);
+      statistics.Add(instr.opcode, aarch64::kCycles,
+                     aarch64::ReadCycleCounter() - start);
+    } else {
+      lifted = Lift(instr, il);
+    }
+
+    if (!lifted) {
+      statistics.Add(instr.opcode, aarch64::kRejected);
+      return LiftWithBase(data, addr, len, il, instr.opcode);
+    }
+
+    statistics.Add(instr.opcode, aarch64::kLifted);
+    state.liftOpcode = instr.opcode;
+    state.liftFallback = false;
+    len = 4;
+    return true;
+  }
+
+  bool GetInstructionInfo(const uint8_t* data, uint64_t addr, size_t maxLen,
+                          InstructionInfo& result) override {
+    EnsureInitialized();
+    // The authenticated branches are the only instructions whose branch information the extension provides, so that
+    // returns and indirect branches end the function and its blocks whatever the base architecture makes of them
+    if (maxLen >= 4 && aarch64::IsBranchToRegister(ReadWord(data))) {
+      const aarch64::DecodeCacheEntry* entry = Decode(data, addr, maxLen);
+      if (entry != nullptr && entry->verdict == aarch64::Verdict::Supported &&
+          entry->instr.opcode >= aarch64::Opcode::RETAA &&
+          entry->instr.opcode <= aarch64::Opcode::BLRAB) {
+        result.length = 4;
+        switch (entry->instr.opcode) {
+        case aarch64::Opcode::RETAA:
+        case aarch64::Opcode::RETAB:
+          result.AddBranch(FunctionReturn);
+          break;
+        case aarch64::Opcode::BRAA:
+        case aarch64::Opcode::BRAB:
+          result.AddBranch(UnresolvedBranch);
+          break;
+        default:
+          // Calls to a register have no branch, analysis continues after them
+          break;
+        }
+        return true;
+      }
+    }
+
+    return ArchitectureHook::GetInstructionInfo(data, addr, maxLen, result);
+  }
+
+  bool GetInstructionLowLevelIL(const uint8_t* data, uint64_t addr, size_t& len,
+                                LowLevelILFunction& il) override {
+    EnsureInitialized();
+    ThreadState& state = GetThreadState();
+    aarch64::SequenceTracker& sequence = state.sequence;
+    // Register values carry over only within a basic block, a block start may be reached with other values
+    if (sequence.Begin(il.GetObject(), addr, il.GetInstructionCount()) &&
+        il.GetLabelForAddress(this, addr) != nullptr) {
+      sequence.Reset();
+    }
+
+    bool lifted;
+    if (mTraceInterval != 0 && GetTrace(state).Sample(mTraceInterval)) {
+      uint64_t start = aarch64::ReadTraceClock();
+      lifted = LiftInstruction(data, addr, len, il);
+      state.trace->Record(addr, start, aarch64::ReadTraceClock(),
+                          state.liftOpcode, state.liftFallback);
+    } else {
+      lifted = LiftInstruction(data, addr, len, il);
+    }
+    sequence.End(addr + 4, il.GetInstructionCount());
+
+    return lifted;
+  }
+
+  /**
+   * Size in bytes of an intrinsic operand, resolving the sizes that stand for the Z and P registers. Without them the
+   * scalable vector intrinsics are never emitted, and are typed for the minimum vector length of 128 bits
+   */
+  size_t GetIntrinsicOperandSize(uint8_t size) {
+    EnsureInitialized();
+    switch (size) {
+    case aarch64::kScalableVectorSize:
+      return mScalable ? mScalableRegisters[0].size : 16;
+    case aarch64::kPredicateSize:
+      return mScalable ? mPredicateRegisters[0].size : 2;
+    default:
+      return size;
+    }
+  }
+
+  std::string GetIntrinsicName(uint32_t intrinsic) override {
+    if (intrinsic - kIntrinsicBase < aarch64::kIntrinsicCount) {
+      return aarch64::kIntrinsics[intrinsic - kIntrinsicBase].name;
+    }
+
+    return ArchitectureHook::GetIntrinsicName(intrinsic);
+  }
+
+  std::vector<uint32_t> GetAllIntrinsics() override {
+    std::vector<uint32_t> intrinsics = ArchitectureHook::GetAllIntrinsics();
+    for (uint32_t i = 0; i < aarch64::kIntrinsicCount; i++) {
+      intrinsics.push_back(kIntrinsicBase + i);
+    }
+
+    return intrinsics;
+  }
+
+  std::vector<NameAndType> GetIntrinsicInputs(uint32_t intrinsic) override {
+    if (intrinsic - kIntrinsicBase >= aarch64::kIntrinsicCount) {
+      return ArchitectureHook::GetIntrinsicInputs(intrinsic);
+    }
+
+    const aarch64::IntrinsicDefinition& definition =
+        aarch64::kIntrinsics[intrinsic - kIntrinsicBase];
+    std::vector<NameAndType> inputs;
+    for (size_t i = 0; i < definition.inputCount; i++) {
+      inputs.push_back(NameAndType(Type::IntegerType(
+          GetIntrinsicOperandSize(definition.inputSizes[i]), false)));
+    }
+
+    return inputs;
+  }
+
+  std::vector<Confidence<Ref<Type>>>
+  GetIntrinsicOutputs(uint32_t intrinsic) override {
+    if (intrinsic - kIntrinsicBase >= aarch64::kIntrinsicCount) {
+      return ArchitectureHook::GetIntrinsicOutputs(intrinsic);
+    }
+
+    const aarch64::IntrinsicDefinition& definition =
+        aarch64::kIntrinsics[intrinsic - kIntrinsicBase];
+    std::vector<Confidence<Ref<Type>>> outputs;
+    if (definition.outputSize != 0) {
+      outputs.push_back(Type::IntegerType(
+          GetIntrinsicOperandSize(definition.outputSize), false));
+    }
+
+    return outputs;
+  }
+};
+
+/**
+ * Format the lift statistics of all threads, one line per mnemonic that was seen
+ */
+static std::string FormatStatistics() {
+  aarch64::StatisticsTotals totals = aarch64::ThreadStatistics::GetTotals();
+
+  std::string report = "AArch64 lift statistics:\n";
+  char line[160];
+  snprintf(line, sizeof(line), "%-10s %12s %12s %12s %12s %10s\n", "mnemonic",
+           "attempted", "lifted", "rejected", "fallback", "cycles/lift");
+  report += line;
+
+  for (size_t opcode = 0; opcode < aarch64::kOpcodeCount; opcode++) {
+    const uint64_t* counters = totals.lift[opcode];
+    if (counters[aarch64::kAttempted] == 0 &&
+        counters[aarch64::kFallback] == 0) {
+      continue;
+    }
+
+    double cycles = counters[aarch64::kAttempted] != 0
+                        ? static_cast<double>(counters[aarch64::kCycles]) /
+                              counters[aarch64::kAttempted]
+                        : 0.0;
+    snprintf(line, sizeof(line),
+             "%-10s %12" PRIu64 " %12" PRIu64 " %12" PRIu64 " %12" PRIu64
+             " %10.1f\n",
+             aarch64::GetOpcodeName(static_cast<aarch64::Opcode>(opcode)),
+             counters[aarch64::kAttempted], counters[aarch64::kLifted],
+             counters[aarch64::kRejected], counters[aarch64::kFallback],
+             cycles);
+    report += line;
+  }
+
+  uint64_t hits = totals.cache[aarch64::kCacheHits];
+  uint64_t lookups = hits + totals.cache[aarch64::kCacheMisses];
+  snprintf(line, sizeof(line),
+           "decode cache: %" PRIu64 " hits, %" PRIu64
+           " misses, %.1f%% hit rate (%zu entries per thread)\n",
+           hits, lookups - hits, lookups != 0 ? 100.0 * hits / lookups : 0.0,
+           aarch64::DecodeCache::kEntries);
+  report += line;
+
+  uint64_t prefetched = totals.cache[aarch64::kPrefetched];
+  uint64_t used = totals.cache[aarch64::kPrefetchHits];
+  snprintf(line, sizeof(line),
+           "decode prefetch: %" PRIu64 " decoded ahead, %" PRIu64
+           " used, %.1f%% use rate\n",
+           prefetched, used,
+           prefetched != 0 ? 100.0 * used / prefetched : 0.0);
+  report += line;
+
+  snprintf(line, sizeof(line),
+           "decode store: %" PRIu64 " misses served from the database\n",
+           totals.cache[aarch64::kStoreHits]);
+  report += line;
+
+  snprintf(line, sizeof(line),
+           "decode prescan: %" PRIu64 " instructions skipped undecoded\n",
+           totals.cache[aarch64::kPrescanSkips]);
+  report += line;
+
+  return report;
+}
+
+/**
+ * Write the sampled lift events of all threads to a Chrome trace event JSON file
+ *
+ * @return false if the file could not be written
+ */
+static bool ExportTrace(const std::string& path) {
+  std::vector<aarch64::TraceEvent> events = aarch64::ThreadTrace::GetEvents();
+  std::string json = aarch64::FormatChromeTrace(events);
+
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+  if (fclose(file) != 0 || !written) {
+    return false;
+  }
+
+  LogInfo("Exported %zu lift events to %s", events.size(), path.c_str());
+  return true;
+}
+
+// Dumps the statistics to stderr on exit when enabled. stderr rather than the log, since the core may already be shut
+// down by then
+static struct StatisticsDump {
+  bool enabled = false;
+
+  ~StatisticsDump() {
+    if (enabled) {
+      fputs(FormatStatistics().c_str(), stderr);
+    }
+  }
+} statisticsDump;
+
+/**
+ * Drops the state kept for a view when the core destroys it, so that none of it outlives the view or is found again
+ * under the address of a view created later
+ */
+class ViewDestructor : public ObjectDestructor {
+private:
+  AArch64ArchitectureExtension* mExtension;
+
+public:
+  explicit ViewDestructor(AArch64ArchitectureExtension* extension)
+      : mExtension(extension) {
+  }
+
+  void DestructBinaryView(BinaryView* view) override {
+    aarch64::DecodeStoreRegistry::Get().Set(view->GetObject(), nullptr);
+    mExtension->ReleasePrescan(view);
+  }
+};
+
+extern "C" {
+BINARYNINJAPLUGIN void CorePluginDependencies() {
+  AddRequiredPluginDependency("arch_arm64");
+}
+
+BINARYNINJAPLUGIN bool CorePluginInit() {
+  Architecture* aarch64 = Architecture::GetByName("aarch64");
+  if (aarch64 == nullptr) {
+    LogError("AArch64 architecture is not available");
+    return false;
+  }
+
+  // Only registers the hook and the settings, which costs next to nothing. The register tables and the enabled
+  // lifters are built on the first use of the architecture, so that sessions without AArch64 views never pay for them
+  AArch64ArchitectureExtension* aarch64Ext =
+      new AArch64ArchitectureExtension(aarch64);
+  AArch64ArchitectureExtension::RegisterSettings();
+  Architecture::Register(aarch64Ext);
+
+  statisticsDump.enabled =
+      Settings::Instance()->Get<bool>("aarch64ext.stats.dumpOnExit");
+
+  // Registered on construction, and never destroyed, like the extension
+  new ViewDestructor(aarch64Ext);
+
+  if (Settings::Instance()->Get<bool>("aarch64ext.decode.persist")) {
+    BinaryViewType::RegisterBinaryViewFinalizationEvent(
+        &AArch64ArchitectureExtension::LoadDecodeStore);
+    BinaryViewType::RegisterBinaryViewInitialAnalysisCompletionEvent(
+        &AArch64ArchitectureExtension::SaveDecodeStore);
+  }
+
+  if (Settings::Instance()->Get<bool>("aarch64ext.decode.prescan")) {
+    BinaryViewType::RegisterBinaryViewFinalizationEvent(
+        [aarch64Ext](BinaryView* view) { aarch64Ext->PrescanView(view); });
+  }
+
+  PluginCommand::Register(
+      "AArch64 Extensions\\Show lift statistics",
+      "Log per-mnemonic lift counters and decode cache hits of all threads",
+      [](BinaryView*) { LogInfo("%s", FormatStatistics().c_str()); });
+
+  PluginCommand::Register(
+      "AArch64 Extensions\\Export lift trace",
+      "Save the sampled lift events of all threads as a Chrome trace event "
+      "file, for chrome://tracing or Perfetto",
+      [](BinaryView*) {
+        if (Settings::Instance()->Get<uint64_t>(
+                "aarch64ext.trace.sampleInterval") == 0) {
+          LogWarn("Lift tracing is disabled, set "
+                  "aarch64ext.trace.sampleInterval and restart");
+        }
+
+        std::string path;
+        if (GetSaveFileNameInput(path, "Lift trace", "*.json",
+                                 "aarch64_lift_trace.json") &&
+            !ExportTrace(path)) {
+          LogError("Failed to write the lift trace to %s", path.c_str());
+        }
+      });
+
+  LogInfo("Registered AArch64 extensions plugin");
+
+  return true;
+}
 }
-}
\ No newline at end of file
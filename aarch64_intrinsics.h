@@ -0,0 +1,357 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Intrinsics emitted by the lifters, for the operations that have no direct IL equivalent. They are numbered from
+// zero here, the extension offsets them past the intrinsics of the base architecture
+
+namespace aarch64 {
+
+enum class Intrinsic : uint32_t {
+  // Lane-wise vector arithmetic, one intrinsic per arrangement, in GetArrangementIndex order
+  VAdd8B,
+  VAdd16B,
+  VAdd4H,
+  VAdd8H,
+  VAdd2S,
+  VAdd4S,
+  VAdd2D,
+  VSub8B,
+  VSub16B,
+  VSub4H,
+  VSub8H,
+  VSub2S,
+  VSub4S,
+  VSub2D,
+  // Table lookups over 1 to 4 table registers, 8B then 16B indices for each table length
+  Tbl1x8B,
+  Tbl1x16B,
+  Tbl2x8B,
+  Tbl2x16B,
+  Tbl3x8B,
+  Tbl3x16B,
+  Tbl4x8B,
+  Tbl4x16B,
+  // LSE atomics, one family per operation in the order of their opcodes, B, H, W then X in each family
+  LdAddB,
+  LdAddH,
+  LdAddW,
+  LdAddX,
+  LdClrB,
+  LdClrH,
+  LdClrW,
+  LdClrX,
+  LdEorB,
+  LdEorH,
+  LdEorW,
+  LdEorX,
+  LdSetB,
+  LdSetH,
+  LdSetW,
+  LdSetX,
+  SwpB,
+  SwpH,
+  SwpW,
+  SwpX,
+  CasB,
+  CasH,
+  CasW,
+  CasX,
+  // Cryptographic extension, one intrinsic per instruction in the order of their opcodes
+  Aese,
+  Aesd,
+  Aesmc,
+  Aesimc,
+  Sha1c,
+  Sha1p,
+  Sha1m,
+  Sha1su0,
+  Sha256h,
+  Sha256h2,
+  Sha256su1,
+  Sha1h,
+  Sha1su1,
+  Sha256su0,
+  Sha512h,
+  Sha512h2,
+  Sha512su1,
+  Sha512su0,
+  // Polynomial multiplication of 8B or 1D elements, PMULL2 takes the upper halves of the same registers
+  Pmull8H,
+  Pmull1Q,
+  // CRC32 then CRC32C, B, H, W then X data in each
+  Crc32B,
+  Crc32H,
+  Crc32W,
+  Crc32X,
+  Crc32CB,
+  Crc32CH,
+  Crc32CW,
+  Crc32CX,
+  // Pointer signing and authentication with each key, then the stripping of an instruction or a data pointer, in the
+  // order of their opcodes
+  Pacia,
+  Pacib,
+  Pacda,
+  Pacdb,
+  Autia,
+  Autib,
+  Autda,
+  Autdb,
+  Xpaci,
+  Xpacd,
+  // Scalable vector extension, for any vector length. Compares of vectors, then with an immediate, in the order of
+  // their opcodes. PTEST yields the N and C flags of a predicate result
+  SveCnt,
+  SvePtrue,
+  SveWhileLt,
+  SveWhileLe,
+  SveWhileLo,
+  SveWhileLs,
+  SveLd1,
+  SveSt1,
+  SveAdd,
+  SveSub,
+  SveAddM,
+  SveSubM,
+  SveCmpEq,
+  SveCmpNe,
+  SveCmpGe,
+  SveCmpGt,
+  SveCmpHs,
+  SveCmpHi,
+  SveCmpEqImm,
+  SveCmpNeImm,
+  SveCmpGeImm,
+  SveCmpGtImm,
+  SveCmpLtImm,
+  SveCmpLeImm,
+  SvePtestFirst,
+  SvePtestNlast,
+  Count
+};
+
+constexpr size_t kIntrinsicCount = static_cast<size_t>(Intrinsic::Count);
+
+constexpr size_t kMaxIntrinsicInputs = 5;
+
+// Operand sizes standing for the Z and P registers, whose size the extension takes from the base architecture
+constexpr uint8_t kScalableVectorSize = 0xFF;
+constexpr uint8_t kPredicateSize = 0xFE;
+
+/**
+ * Signature of an intrinsic, all operands are unsigned integers of the given sizes in bytes
+ *
+ * The 64-bit vector arrangements output the whole Q register with the upper half zeroed, as the instructions do
+ *
+ * The atomics take the address, the register operands and the memory ordering, kOrderAcquire and kOrderRelease bits,
+ * and output the value memory held before the operation. The byte and halfword forms take and output W registers,
+ * zero-extended as the instructions load them
+ *
+ * The scalable vector intrinsics take the element size in bytes as their last input, rather than one intrinsic per
+ * element size, since their Z and P operands are the same whatever the element size
+ */
+struct IntrinsicDefinition {
+  const char* name;
+  uint8_t inputCount;
+  uint8_t inputSizes[kMaxIntrinsicInputs];
+  uint8_t outputSize;
+};
+
+constexpr IntrinsicDefinition kIntrinsics[] = {
+    {"vadd.8b", 2, {8, 8}, 16},
+    {"vadd.16b", 2, {16, 16}, 16},
+    {"vadd.4h", 2, {8, 8}, 16},
+    {"vadd.8h", 2, {16, 16}, 16},
+    {"vadd.2s", 2, {8, 8}, 16},
+    {"vadd.4s", 2, {16, 16}, 16},
+    {"vadd.2d", 2, {16, 16}, 16},
+    {"vsub.8b", 2, {8, 8}, 16},
+    {"vsub.16b", 2, {16, 16}, 16},
+    {"vsub.4h", 2, {8, 8}, 16},
+    {"vsub.8h", 2, {16, 16}, 16},
+    {"vsub.2s", 2, {8, 8}, 16},
+    {"vsub.4s", 2, {16, 16}, 16},
+    {"vsub.2d", 2, {16, 16}, 16},
+    {"tbl1.8b", 2, {16, 8}, 16},
+    {"tbl1.16b", 2, {16, 16}, 16},
+    {"tbl2.8b", 3, {16, 16, 8}, 16},
+    {"tbl2.16b", 3, {16, 16, 16}, 16},
+    {"tbl3.8b", 4, {16, 16, 16, 8}, 16},
+    {"tbl3.16b", 4, {16, 16, 16, 16}, 16},
+    {"tbl4.8b", 5, {16, 16, 16, 16, 8}, 16},
+    {"tbl4.16b", 5, {16, 16, 16, 16, 16}, 16},
+    {"ldadd.b", 3, {8, 4, 1}, 4},
+    {"ldadd.h", 3, {8, 4, 1}, 4},
+    {"ldadd.w", 3, {8, 4, 1}, 4},
+    {"ldadd.x", 3, {8, 8, 1}, 8},
+    {"ldclr.b", 3, {8, 4, 1}, 4},
+    {"ldclr.h", 3, {8, 4, 1}, 4},
+    {"ldclr.w", 3, {8, 4, 1}, 4},
+    {"ldclr.x", 3, {8, 8, 1}, 8},
+    {"ldeor.b", 3, {8, 4, 1}, 4},
+    {"ldeor.h", 3, {8, 4, 1}, 4},
+    {"ldeor.w", 3, {8, 4, 1}, 4},
+    {"ldeor.x", 3, {8, 8, 1}, 8},
+    {"ldset.b", 3, {8, 4, 1}, 4},
+    {"ldset.h", 3, {8, 4, 1}, 4},
+    {"ldset.w", 3, {8, 4, 1}, 4},
+    {"ldset.x", 3, {8, 8, 1}, 8},
+    {"swp.b", 3, {8, 4, 1}, 4},
+    {"swp.h", 3, {8, 4, 1}, 4},
+    {"swp.w", 3, {8, 4, 1}, 4},
+    {"swp.x", 3, {8, 8, 1}, 8},
+    // Compared value, then the value stored if memory holds it
+    {"cas.b", 4, {8, 4, 4, 1}, 4},
+    {"cas.h", 4, {8, 4, 4, 1}, 4},
+    {"cas.w", 4, {8, 4, 4, 1}, 4},
+    {"cas.x", 4, {8, 8, 8, 1}, 8},
+    // The AES rounds and the SHA hash updates read the destination as well
+    {"aese", 2, {16, 16}, 16},
+    {"aesd", 2, {16, 16}, 16},
+    {"aesmc", 1, {16}, 16},
+    {"aesimc", 1, {16}, 16},
+    {"sha1c", 3, {16, 4, 16}, 16},
+    {"sha1p", 3, {16, 4, 16}, 16},
+    {"sha1m", 3, {16, 4, 16}, 16},
+    {"sha1su0", 3, {16, 16, 16}, 16},
+    {"sha256h", 3, {16, 16, 16}, 16},
+    {"sha256h2", 3, {16, 16, 16}, 16},
+    {"sha256su1", 3, {16, 16, 16}, 16},
+    // S register input, the result is written to the whole Q register with the upper bits zeroed
+    {"sha1h", 1, {4}, 16},
+    {"sha1su1", 2, {16, 16}, 16},
+    {"sha256su0", 2, {16, 16}, 16},
+    {"sha512h", 3, {16, 16, 16}, 16},
+    {"sha512h2", 3, {16, 16, 16}, 16},
+    {"sha512su1", 3, {16, 16, 16}, 16},
+    {"sha512su0", 2, {16, 16}, 16},
+    {"pmull.8h", 2, {8, 8}, 16},
+    {"pmull.1q", 2, {8, 8}, 16},
+    // Accumulator, then the data
+    {"crc32b", 2, {4, 1}, 4},
+    {"crc32h", 2, {4, 2}, 4},
+    {"crc32w", 2, {4, 4}, 4},
+    {"crc32x", 2, {4, 8}, 4},
+    {"crc32cb", 2, {4, 1}, 4},
+    {"crc32ch", 2, {4, 2}, 4},
+    {"crc32cw", 2, {4, 4}, 4},
+    {"crc32cx", 2, {4, 8}, 4},
+    // Pointer, then the modifier
+    {"pacia", 2, {8, 8}, 8},
+    {"pacib", 2, {8, 8}, 8},
+    {"pacda", 2, {8, 8}, 8},
+    {"pacdb", 2, {8, 8}, 8},
+    {"autia", 2, {8, 8}, 8},
+    {"autib", 2, {8, 8}, 8},
+    {"autda", 2, {8, 8}, 8},
+    {"autdb", 2, {8, 8}, 8},
+    {"xpaci", 1, {8}, 8},
+    {"xpacd", 1, {8}, 8},
+    // Number of elements selected by a pattern
+    {"sve.cnt", 2, {1, 1}, 8},
+    {"sve.ptrue", 2, {1, 1}, kPredicateSize},
+    {"sve.whilelt", 3, {8, 8, 1}, kPredicateSize},
+    {"sve.whilele", 3, {8, 8, 1}, kPredicateSize},
+    {"sve.whilelo", 3, {8, 8, 1}, kPredicateSize},
+    {"sve.whilels", 3, {8, 8, 1}, kPredicateSize},
+    // Governing predicate and address, inactive elements are zeroed or not stored
+    {"sve.ld1", 3, {kPredicateSize, 8, 1}, kScalableVectorSize},
+    {"sve.st1", 4, {kScalableVectorSize, kPredicateSize, 8, 1}, 0},
+    {"sve.add", 3, {kScalableVectorSize, kScalableVectorSize, 1},
+     kScalableVectorSize},
+    {"sve.sub", 3, {kScalableVectorSize, kScalableVectorSize, 1},
+     kScalableVectorSize},
+    {"sve.add.m",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kScalableVectorSize},
+    {"sve.sub.m",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kScalableVectorSize},
+    {"sve.cmpeq",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmpne",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmpge",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmpgt",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmphs",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmphi",
+     4,
+     {kPredicateSize, kScalableVectorSize, kScalableVectorSize, 1},
+     kPredicateSize},
+    {"sve.cmpeq.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    {"sve.cmpne.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    {"sve.cmpge.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    {"sve.cmpgt.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    {"sve.cmplt.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    {"sve.cmple.imm", 4, {kPredicateSize, kScalableVectorSize, 8, 1},
+     kPredicateSize},
+    // Governing predicate, then the tested predicate: its first active element is set, its last active one is clear
+    {"sve.ptest.first", 2, {kPredicateSize, kPredicateSize}, 1},
+    {"sve.ptest.nlast", 2, {kPredicateSize, kPredicateSize}, 1},
+};
+
+static_assert(sizeof(kIntrinsics) / sizeof(kIntrinsics[0]) == kIntrinsicCount,
+              "kIntrinsics must have a definition for every intrinsic");
+
+/**
+ * Index of a vector arrangement among 8B, 16B, 4H, 8H, 2S, 4S and 2D
+ *
+ * @param size register size in bytes, 8 or 16
+ * @param esize element size in bytes
+ */
+inline uint32_t GetArrangementIndex(size_t size, size_t esize) {
+  switch (esize) {
+  case 1:
+    return size == 16;
+  case 2:
+    return 2 + (size == 16);
+  case 4:
+    return 4 + (size == 16);
+  default:
+    return 6;
+  }
+}
+
+/**
+ * Index of an access size of 1, 2, 4 or 8 bytes among the B, H, W and X forms of an atomic
+ */
+inline uint32_t GetAccessSizeIndex(size_t size) {
+  switch (size) {
+  case 1:
+    return 0;
+  case 2:
+    return 1;
+  case 4:
+    return 2;
+  default:
+    return 3;
+  }
+}
+
+inline Intrinsic OffsetIntrinsic(Intrinsic first, uint32_t index) {
+  return static_cast<Intrinsic>(static_cast<uint32_t>(first) + index);
+}
+
+} // namespace aarch64
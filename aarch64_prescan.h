@@ -0,0 +1,369 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define AARCH64_PRESCAN_NEON
+#elif (defined(__x86_64__) || defined(__i386__)) &&                            \
+    (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define AARCH64_PRESCAN_AVX2
+#endif
+
+#include "aarch64_decoder.h"
+
+// Prescan of the executable segments of a view: one bit per instruction slot, set if the word there matches one of
+// the enabled encoding classes. A clear bit means the lifters would not decode the word anyway, so the lift callback
+// hands it straight to the base lifter without a decode cache lookup. A set bit, or an address outside of the
+// scanned ranges, goes through the usual decode
+
+namespace aarch64 {
+
+/**
+ * Scan count words, little-endian at data, against the encoding classes, one bit per word: bit i % 64 of bits[i / 64]
+ * is set if word i matches any of them. Portable version of the vector kernels below
+ */
+inline void ScanWordsScalar(const uint8_t* data, size_t count,
+                            const EncodingClass* classes, size_t classCount,
+                            uint64_t* bits) {
+  std::memset(bits, 0, (count + 63) / 64 * sizeof(uint64_t));
+  for (size_t i = 0; i < count; i++) {
+    const uint8_t* bytes = data + i * 4;
+    uint32_t word = static_cast<uint32_t>(bytes[0]) |
+                    static_cast<uint32_t>(bytes[1]) << 8 |
+                    static_cast<uint32_t>(bytes[2]) << 16 |
+                    static_cast<uint32_t>(bytes[3]) << 24;
+    for (size_t c = 0; c < classCount; c++) {
+      if ((word & classes[c].mask) == classes[c].value) {
+        bits[i / 64] |= 1ull << (i % 64);
+        break;
+      }
+    }
+  }
+}
+
+#ifdef AARCH64_PRESCAN_AVX2
+/**
+ * ScanWordsScalar eight words at a time, only called once the CPU is known to support AVX2
+ */
+__attribute__((target("avx2"))) inline void
+ScanWordsAvx2(const uint8_t* data, size_t count, const EncodingClass* classes,
+              size_t classCount, uint64_t* bits) {
+  size_t vectorCount = count & ~static_cast<size_t>(7);
+  // Blocks of eight never straddle two bitmap words
+  for (size_t i = 0; i < vectorCount; i += 8) {
+    __m256i words = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(data + i * 4));
+    __m256i match = _mm256_setzero_si256();
+    for (size_t c = 0; c < classCount; c++) {
+      __m256i mask = _mm256_set1_epi32(static_cast<int>(classes[c].mask));
+      __m256i value = _mm256_set1_epi32(static_cast<int>(classes[c].value));
+      match = _mm256_or_si256(
+          match, _mm256_cmpeq_epi32(_mm256_and_si256(words, mask), value));
+    }
+
+    uint64_t lanes = static_cast<uint32_t>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(match)));
+    if (i % 64 == 0) {
+      bits[i / 64] = lanes;
+    } else {
+      bits[i / 64] |= lanes << (i % 64);
+    }
+  }
+
+  if (vectorCount != count) {
+    uint64_t tail[1];
+    ScanWordsScalar(data + vectorCount * 4, count - vectorCount, classes,
+                    classCount, tail);
+    if (vectorCount % 64 == 0) {
+      bits[vectorCount / 64] = tail[0];
+    } else {
+      bits[vectorCount / 64] |= tail[0] << (vectorCount % 64);
+    }
+  }
+}
+#endif
+
+#ifdef AARCH64_PRESCAN_NEON
+/**
+ * ScanWordsScalar four words at a time, Advanced SIMD is always available on AArch64
+ */
+inline void ScanWordsNeon(const uint8_t* data, size_t count,
+                          const EncodingClass* classes, size_t classCount,
+                          uint64_t* bits) {
+  static const uint32_t kLaneBits[4] = {1, 2, 4, 8};
+  uint32x4_t laneBits = vld1q_u32(kLaneBits);
+
+  size_t vectorCount = count & ~static_cast<size_t>(3);
+  // Blocks of four never straddle two bitmap words
+  for (size_t i = 0; i < vectorCount; i += 4) {
+    uint32x4_t words = vreinterpretq_u32_u8(vld1q_u8(data + i * 4));
+    uint32x4_t match = vdupq_n_u32(0);
+    for (size_t c = 0; c < classCount; c++) {
+      uint32x4_t masked = vandq_u32(words, vdupq_n_u32(classes[c].mask));
+      match = vorrq_u32(match,
+                        vceqq_u32(masked, vdupq_n_u32(classes[c].value)));
+    }
+
+    uint64_t lanes = vaddvq_u32(vandq_u32(match, laneBits));
+    if (i % 64 == 0) {
+      bits[i / 64] = lanes;
+    } else {
+      bits[i / 64] |= lanes << (i % 64);
+    }
+  }
+
+  if (vectorCount != count) {
+    uint64_t tail[1];
+    ScanWordsScalar(data + vectorCount * 4, count - vectorCount, classes,
+                    classCount, tail);
+    if (vectorCount % 64 == 0) {
+      bits[vectorCount / 64] = tail[0];
+    } else {
+      bits[vectorCount / 64] |= tail[0] << (vectorCount % 64);
+    }
+  }
+}
+#endif
+
+/**
+ * Scan words with the fastest kernel the host supports, see ScanWordsScalar
+ */
+inline void ScanWords(const uint8_t* data, size_t count,
+                      const EncodingClass* classes, size_t classCount,
+                      uint64_t* bits) {
+#if defined(AARCH64_PRESCAN_NEON)
+  ScanWordsNeon(data, count, classes, classCount, bits);
+#elif defined(AARCH64_PRESCAN_AVX2)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+  if (avx2) {
+    ScanWordsAvx2(data, count, classes, classCount, bits);
+  } else {
+    ScanWordsScalar(data, count, classes, classCount, bits);
+  }
+#else
+  ScanWordsScalar(data, count, classes, classCount, bits);
+#endif
+}
+
+/**
+ * Prescan bitmap of the executable ranges of a view. The ranges are fixed once allocated, the bits are atomics so
+ * that a page can be scanned again after a patch while other threads test them
+ */
+class PrescanBitmap {
+public:
+  // Slots scanned again together when bytes are patched, 4 KiB of instructions
+  static constexpr size_t kPageSlots = 1024;
+
+  /**
+   * Slots of a range scanned together, a whole number of pages
+   */
+  struct Chunk {
+    uint64_t addr;
+    size_t slots;
+    size_t firstWord;
+  };
+
+private:
+  struct Range {
+    uint64_t start;
+    uint64_t end;
+    // Index of the first bitmap word of the range
+    size_t firstWord;
+  };
+
+  std::vector<Range> mRanges;
+  std::unique_ptr<std::atomic<uint64_t>[]> mBits;
+  size_t mWordCount = 0;
+
+  const Range* FindRange(uint64_t addr) const {
+    for (const Range& range : mRanges) {
+      if (addr >= range.start && addr < range.end) {
+        return &range;
+      }
+    }
+    return nullptr;
+  }
+
+public:
+  /**
+   * Add an address range, must be called for every range before Allocate
+   */
+  void AddRange(uint64_t start, uint64_t end) {
+    // Slots are 4-byte aligned, a misaligned head cannot hold an instruction the core would lift
+    start = (start + 3) & ~static_cast<uint64_t>(3);
+    if (end <= start) {
+      return;
+    }
+
+    size_t slots = static_cast<size_t>((end - start + 3) / 4);
+    mRanges.push_back({start, end, mWordCount});
+    mWordCount += (slots + kPageSlots - 1) / kPageSlots * (kPageSlots / 64);
+  }
+
+  /**
+   * Allocate the bitmap with every bit set, so that nothing is skipped before it is scanned
+   */
+  void Allocate() {
+    mBits.reset(new std::atomic<uint64_t>[mWordCount]);
+    for (size_t i = 0; i < mWordCount; i++) {
+      mBits[i].store(~0ull, std::memory_order_relaxed);
+    }
+  }
+
+  bool IsEmpty() const {
+    return mRanges.empty();
+  }
+
+  /**
+   * Split the ranges into chunks of at most maxSlots, rounded up to whole pages, to be scanned in parallel
+   */
+  std::vector<Chunk> GetChunks(size_t maxSlots) const {
+    maxSlots = std::max(maxSlots / kPageSlots, static_cast<size_t>(1)) *
+               kPageSlots;
+
+    std::vector<Chunk> chunks;
+    for (const Range& range : mRanges) {
+      size_t slots = static_cast<size_t>((range.end - range.start + 3) / 4);
+      for (size_t slot = 0; slot < slots; slot += maxSlots) {
+        chunks.push_back({range.start + slot * 4,
+                          std::min(maxSlots, slots - slot),
+                          range.firstWord + slot / 64});
+      }
+    }
+    return chunks;
+  }
+
+  /**
+   * Pages overlapping [addr, addr + length) that are scanned, as one chunk each
+   */
+  std::vector<Chunk> GetPages(uint64_t addr, uint64_t length) const {
+    std::vector<Chunk> pages;
+    for (const Range& range : mRanges) {
+      uint64_t start = std::max(addr, range.start);
+      uint64_t end = std::min(addr + length, range.end);
+      if (start >= end) {
+        continue;
+      }
+
+      size_t slots = static_cast<size_t>((range.end - range.start + 3) / 4);
+      size_t first = static_cast<size_t>((start - range.start) / 4);
+      size_t last = static_cast<size_t>((end - 1 - range.start) / 4);
+      for (size_t page = first / kPageSlots; page <= last / kPageSlots;
+           page++) {
+        size_t slot = page * kPageSlots;
+        pages.push_back({range.start + slot * 4,
+                         std::min(kPageSlots, slots - slot),
+                         range.firstWord + slot / 64});
+      }
+    }
+    return pages;
+  }
+
+  /**
+   * Set every bit of a chunk, before its bytes are read again
+   */
+  void Invalidate(const Chunk& chunk) {
+    for (size_t i = 0; i < (chunk.slots + 63) / 64; i++) {
+      mBits[chunk.firstWord + i].store(~0ull, std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Scan the bytes of a chunk, length may be short of the chunk if the view does not back all of it, the slots past
+   * the bytes are left set
+   */
+  void Scan(const Chunk& chunk, const uint8_t* data, size_t length,
+            const EncodingClass* classes, size_t classCount,
+            std::vector<uint64_t>& scratch) {
+    size_t count = std::min(chunk.slots, length / 4);
+    scratch.resize((count + 63) / 64);
+    ScanWords(data, count, classes, classCount, scratch.data());
+    for (size_t i = 0; i < count / 64; i++) {
+      mBits[chunk.firstWord + i].store(scratch[i], std::memory_order_relaxed);
+    }
+
+    if (count % 64 != 0) {
+      uint64_t unread = ~0ull << (count % 64);
+      mBits[chunk.firstWord + count / 64].store(scratch[count / 64] | unread,
+                                                std::memory_order_relaxed);
+    }
+  }
+
+  /**
+   * Test the bit of an address
+   *
+   * @return false only if the word at addr was scanned and matches none of the encoding classes
+   */
+  bool MayNeedLift(uint64_t addr) const {
+    const Range* range = (addr & 3) == 0 ? FindRange(addr) : nullptr;
+    if (range == nullptr) {
+      return true;
+    }
+
+    size_t slot = static_cast<size_t>((addr - range->start) / 4);
+    uint64_t word =
+        mBits[range->firstWord + slot / 64].load(std::memory_order_relaxed);
+    return (word >> (slot % 64) & 1) != 0;
+  }
+};
+
+/**
+ * Prescan bitmaps of the views opened in this process, at most one per view
+ */
+class PrescanRegistry {
+private:
+  std::mutex mMutex;
+  std::vector<std::pair<const void*, std::shared_ptr<PrescanBitmap>>> mBitmaps;
+  std::atomic<uint64_t> mGeneration {0};
+
+public:
+  // Intentionally leaked, like the statistics registry
+  static PrescanRegistry& Get() {
+    static PrescanRegistry* registry = new PrescanRegistry();
+    return *registry;
+  }
+
+  /**
+   * Set the bitmap of a view, replacing its previous one, or remove it if bitmap is nullptr
+   */
+  void Set(const void* view, std::shared_ptr<PrescanBitmap> bitmap) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (auto it = mBitmaps.begin(); it != mBitmaps.end(); ++it) {
+      if (it->first == view) {
+        mBitmaps.erase(it);
+        break;
+      }
+    }
+
+    if (bitmap) {
+      mBitmaps.emplace_back(view, std::move(bitmap));
+    }
+    mGeneration.fetch_add(1, std::memory_order_release);
+  }
+
+  uint64_t GetGeneration() const {
+    return mGeneration.load(std::memory_order_acquire);
+  }
+
+  std::shared_ptr<PrescanBitmap> Find(const void* view) {
+    std::lock_guard<std::mutex> lock(mMutex);
+    for (const auto& entry : mBitmaps) {
+      if (entry.first == view) {
+        return entry.second;
+      }
+    }
+    return nullptr;
+  }
+};
+
+} // namespace aarch64
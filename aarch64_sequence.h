@@ -0,0 +1,472 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace aarch64 {
+
+/**
+ * Recover the divisor of an unsigned division by a constant, compiled as a multiplication by a magic number and a
+ * right shift: the quotient of n / d is (n * magic) >> shift for every n of the given width
+ *
+ * @param magic multiplier
+ * @param bits width of the dividend, 32 or 64
+ * @param shift total right shift of the full product, of at least bits
+ * @param divisor recovered divisor
+ * @return false if no divisor yields exactly this multiplication for every dividend
+ */
+inline bool FindUnsignedDivisor(uint64_t magic, unsigned int bits,
+                                unsigned int shift, uint64_t& divisor) {
+  if (magic == 0 || shift < bits || shift >= 128) {
+    return false;
+  }
+
+  // divisor = ceil(2^shift / magic), by long division
+  uint64_t quotient = 0;
+  uint64_t remainder = 0;
+  for (unsigned int bit = shift + 1; bit-- > 0;) {
+    bool carry = remainder >> 63;
+    remainder = remainder << 1 | (bit == shift);
+    if (quotient >> 63) {
+      return false;
+    }
+
+    quotient <<= 1;
+    if (carry || remainder >= magic) {
+      remainder -= magic;
+      quotient |= 1;
+    }
+  }
+
+  uint64_t error = remainder != 0 ? magic - remainder : 0;
+  if (remainder != 0 && ++quotient == 0) {
+    return false;
+  }
+
+  if (quotient < 2 || (bits < 64 && quotient >> bits != 0)) {
+    return false;
+  }
+
+  // Exact for every dividend when 2^shift <= magic * divisor <= 2^shift + 2^(shift - bits), see Granlund and
+  // Montgomery, "Division by Invariant Integers using Multiplication"
+  if (shift - bits < 64 && error > static_cast<uint64_t>(1) << (shift - bits)) {
+    return false;
+  }
+
+  divisor = quotient;
+  return true;
+}
+
+/**
+ * Recover the divisor of a signed division by a constant, compiled as a signed multiplication by a magic number, an
+ * arithmetic right shift and the addition of the sign bit of the dividend: the quotient of n / d rounded toward zero is
+ * ((n * magic) >> shift) + (n < 0) for every n of the given width
+ *
+ * Only positive divisors and magic numbers are recognized. Those with the top bit set are compiled with an addition of
+ * the dividend to the product, which is not tracked
+ *
+ * @param magic multiplier, a positive signed number of the given width
+ * @param bits width of the dividend, 32 or 64
+ * @param shift total right shift of the full product
+ * @param divisor recovered divisor
+ * @return false if no divisor yields exactly this quotient for every dividend
+ */
+inline bool FindSignedDivisor(uint64_t magic, unsigned int bits,
+                              unsigned int shift, uint64_t& divisor) {
+  // A power of two leaves no error to round the negative dividends up, and is compiled as shifts anyway
+  if (magic >> (bits - 1) != 0 || (magic & (magic - 1)) == 0) {
+    return false;
+  }
+
+  // The magnitude of the dividend has one bit less, with the same bound as an unsigned division of that width
+  return FindUnsignedDivisor(magic, bits - 1, shift, divisor);
+}
+
+/**
+ * Register constants carried from one instruction to the next while a basic block is lifted, owned by a single thread
+ *
+ * The core lifts one instruction at a time and never shows the lifter the instructions that follow, so idioms spread
+ * over several instructions are recognized looking back: each instruction of a sequence records the value it leaves
+ * in its destination, and the last one emits the resolved constant
+ *
+ * State only carries over to an instruction lifted right after the previous one, at the next address of the same IL
+ * function, with nothing emitted in between and no block starting there (checked by the caller). Any instruction that
+ * does not record its effect on the tracked registers, be it lifted by another lifter or by the base architecture,
+ * clears everything
+ */
+class SequenceTracker {
+private:
+  const void* mFunction = nullptr;
+  uint64_t mNext = 0;
+  size_t mInstructionCount = 0;
+  // Set once the current instruction recorded its effect on the tracked registers
+  bool mRecorded = false;
+
+  // Registers 0 to 30 with a known value. Register number 31 is never tracked, be it the stack pointer or the zero
+  // register
+  uint32_t mKnown = 0;
+  // Known values that are addresses, from ADRP
+  uint32_t mPointers = 0;
+  uint64_t mValues[31] {};
+  // Registers 0 to 30 holding the doubleword loaded from a known address, from ADRP+LDR, and their addresses
+  uint32_t mLoaded = 0;
+  uint64_t mLoadAddresses[31] {};
+
+public:
+  /**
+   * Product of a multiplication by a constant, the first half of a division by a constant
+   */
+  struct Product {
+    // Register holding the product
+    uint8_t reg;
+    // Register of the other factor, which the multiplication did not overwrite
+    uint8_t dividend;
+    // Width of the factors, 32 bits for UMULL and 64 bits for UMULH
+    uint8_t bits;
+    uint64_t magic;
+  };
+
+  /**
+   * Signed division by a constant in progress, see FindSignedDivisor
+   */
+  struct SignedDivision {
+    // Register of the dividend, the division is dropped once it is overwritten
+    uint8_t dividend;
+    // Width of the dividend, 32 bits for SMULL and 64 bits for SMULH
+    uint8_t bits;
+    uint64_t magic;
+  };
+
+  /**
+   * Operands of a comparison, Rn - operand, whose flags are those a consumer right after it reads
+   */
+  struct Comparison {
+    uint8_t size;
+    // Register 31 is the stack pointer when comparing with an immediate, the zero register otherwise, as in SUBS
+    uint8_t rn;
+    // The operand is imm, or else Rm shifted left by shift
+    bool hasImmediate;
+    uint64_t imm;
+    uint8_t rm;
+    uint8_t shift;
+  };
+
+private:
+  // Product of the previous instruction, and that of the current one
+  bool mHasProduct = false;
+  bool mSetProduct = false;
+  Product mProduct {};
+
+  // Comparison of the previous instruction, and that of the current one
+  bool mHasComparison = false;
+  bool mSetComparison = false;
+  Comparison mComparison {};
+
+  // Signed division of the current sequence, registers 0 to 30 holding its full product shifted right by
+  // mEstimateShifts, and those holding the sign bit of its dividend, 0 or 1. The shift of the estimates in
+  // mWordEstimates is logical, which leaves the low word alone the same as an arithmetic one
+  bool mHasDivision = false;
+  SignedDivision mDivision {};
+  uint32_t mEstimates = 0;
+  uint32_t mWordEstimates = 0;
+  uint32_t mSignBits = 0;
+  uint8_t mEstimateShifts[31] {};
+
+  // Address and instruction word of the store-exclusive of a loop lifted as an atomic at its exclusive load, which
+  // already performed the store. Kept until the store is lifted
+  bool mHasElidedStore = false;
+  uint64_t mElidedStore = 0;
+  uint32_t mElidedStoreWord = 0;
+
+public:
+  SequenceTracker() = default;
+  SequenceTracker(const SequenceTracker&) = delete;
+  SequenceTracker& operator=(const SequenceTracker&) = delete;
+
+  /**
+   * Start lifting an instruction
+   *
+   * @param function IL function being lifted
+   * @param addr address of the instruction
+   * @param instructionCount number of instructions in function
+   * @return true if register values carried over from the previous instruction, in which case the caller checks that
+   * no basic block starts at addr
+   */
+  bool Begin(const void* function, uint64_t addr, size_t instructionCount) {
+    if (function != mFunction || addr != mNext ||
+        instructionCount != mInstructionCount) {
+      Reset();
+    }
+
+    mFunction = function;
+    mRecorded = false;
+    mSetProduct = false;
+    mSetComparison = false;
+    return mKnown != 0 || mLoaded != 0 || mHasProduct || mHasDivision ||
+           mHasComparison || mHasElidedStore;
+  }
+
+  /**
+   * Forget all register values, e.g. when the instruction can be reached from elsewhere
+   */
+  void Reset() {
+    mKnown = 0;
+    mLoaded = 0;
+    mHasProduct = false;
+    mHasDivision = false;
+    mHasComparison = false;
+    mHasElidedStore = false;
+  }
+
+  /**
+   * Finish lifting an instruction, the state is kept only if the instruction recorded its effect
+   *
+   * @param next address of the next instruction
+   * @param instructionCount number of instructions in the function after lifting
+   */
+  void End(uint64_t next, size_t instructionCount) {
+    if (!mRecorded) {
+      mKnown = 0;
+      mLoaded = 0;
+      mHasDivision = false;
+    }
+
+    // A product is only consumed by the instruction right after the multiplication
+    mHasProduct = mSetProduct;
+    // Likewise a comparison, the flags of any other instruction are not tracked
+    mHasComparison = mSetComparison;
+    // The store is the instruction after next, whatever lifts the one in between
+    if (mHasElidedStore && next > mElidedStore) {
+      mHasElidedStore = false;
+    }
+
+    mNext = next;
+    mInstructionCount = instructionCount;
+  }
+
+  bool GetValue(uint8_t reg, uint64_t& value) const {
+    if (reg >= 31 || !(mKnown >> reg & 1)) {
+      return false;
+    }
+
+    value = mValues[reg];
+    return true;
+  }
+
+  bool IsPointer(uint8_t reg) const {
+    return reg < 31 && (mKnown & mPointers) >> reg & 1;
+  }
+
+  /**
+   * Record the value the current instruction leaves in a register
+   */
+  void SetValue(uint8_t reg, uint64_t value, bool pointer = false) {
+    mRecorded = true;
+    if (reg >= 31) {
+      return;
+    }
+
+    Forget(reg);
+    mKnown |= 1u << reg;
+    mPointers = pointer ? mPointers | 1u << reg : mPointers & ~(1u << reg);
+    mValues[reg] = value;
+  }
+
+  /**
+   * Address a register was loaded from, e.g. the GOT slot that an import stub branches through
+   */
+  bool GetLoadAddress(uint8_t reg, uint64_t& addr) const {
+    if (reg >= 31 || !(mLoaded >> reg & 1)) {
+      return false;
+    }
+
+    addr = mLoadAddresses[reg];
+    return true;
+  }
+
+  /**
+   * Record that the current instruction loads a register with the doubleword at a known address. Since every store
+   * clears the loads, see ClearLoads, the register still holds the doubleword at that address as long as it is tracked
+   */
+  void SetLoadAddress(uint8_t reg, uint64_t addr) {
+    mRecorded = true;
+    if (reg >= 31) {
+      return;
+    }
+
+    Forget(reg);
+    mLoaded |= 1u << reg;
+    mLoadAddresses[reg] = addr;
+  }
+
+  /**
+   * Product left by the previous instruction in a register
+   */
+  bool GetProduct(uint8_t reg, Product& product) const {
+    if (!mHasProduct || mProduct.reg != reg) {
+      return false;
+    }
+
+    product = mProduct;
+    return true;
+  }
+
+  /**
+   * Record the product of a multiplication by a constant left by the current instruction
+   */
+  void SetProduct(const Product& product) {
+    mSetProduct = true;
+    mProduct = product;
+  }
+
+  /**
+   * Record that the current instruction leaves the product of a signed multiplication by a constant in a register,
+   * starting a signed division in place of any other
+   *
+   * @param shift right shift of the full product left in the register, 64 for the high half of SMULH
+   */
+  void SetSignedProduct(uint8_t reg, const SignedDivision& division,
+                        unsigned int shift) {
+    Clear(reg);
+    if (reg >= 31 || reg == division.dividend) {
+      return;
+    }
+
+    mHasDivision = true;
+    mDivision = division;
+    mEstimates = 1u << reg;
+    mWordEstimates = 0;
+    mSignBits = 0;
+    mEstimateShifts[reg] = static_cast<uint8_t>(shift);
+  }
+
+  bool GetSignedDivision(SignedDivision& division) const {
+    if (!mHasDivision) {
+      return false;
+    }
+
+    division = mDivision;
+    return true;
+  }
+
+  /**
+   * Right shift of the full product of the signed division held in a register, when read at the given size
+   */
+  bool GetEstimate(uint8_t reg, size_t size, unsigned int& shift) const {
+    if (!mHasDivision || reg >= 31 || !(mEstimates >> reg & 1) ||
+        (size == 8 && mWordEstimates >> reg & 1)) {
+      return false;
+    }
+
+    shift = mEstimateShifts[reg];
+    return true;
+  }
+
+  /**
+   * Record that the current instruction leaves the full product of the signed division shifted right in a register
+   *
+   * @param word true if only the low word of the register holds the shifted product, as after a logical shift
+   */
+  void SetEstimate(uint8_t reg, unsigned int shift, bool word = false) {
+    Clear(reg);
+    if (!mHasDivision || reg >= 31) {
+      return;
+    }
+
+    mEstimates |= 1u << reg;
+    mWordEstimates = word ? mWordEstimates | 1u << reg
+                          : mWordEstimates & ~(1u << reg);
+    mEstimateShifts[reg] = static_cast<uint8_t>(shift);
+  }
+
+  bool IsSignBit(uint8_t reg) const {
+    return mHasDivision && reg < 31 && mSignBits >> reg & 1;
+  }
+
+  /**
+   * Record that the current instruction leaves the sign bit of the dividend of the signed division in a register
+   */
+  void SetSignBit(uint8_t reg) {
+    Clear(reg);
+    if (mHasDivision && reg < 31) {
+      mSignBits |= 1u << reg;
+    }
+  }
+
+  /**
+   * Comparison whose flags the previous instruction left
+   */
+  bool GetComparison(Comparison& comparison) const {
+    if (!mHasComparison) {
+      return false;
+    }
+
+    comparison = mComparison;
+    return true;
+  }
+
+  /**
+   * Record the comparison whose flags the current instruction leaves, its operands must be left unchanged
+   */
+  void SetComparison(const Comparison& comparison) {
+    mSetComparison = true;
+    mComparison = comparison;
+  }
+
+  /**
+   * Record that the store-exclusive at addr belongs to the loop the current instruction lifted as an atomic
+   *
+   * @param word instruction word of the store-exclusive the loop was matched against
+   */
+  void SetElidedStore(uint64_t addr, uint32_t word) {
+    mHasElidedStore = true;
+    mElidedStore = addr;
+    mElidedStoreWord = word;
+  }
+
+  /**
+   * Claim the store-exclusive at addr, if the atomic lifted at its exclusive load already performed it. The store
+   * lifted must be the very one the loop was matched against, any other is lifted as is
+   */
+  bool TakeElidedStore(uint64_t addr, uint32_t word) {
+    if (!mHasElidedStore || mElidedStore != addr || mElidedStoreWord != word) {
+      return false;
+    }
+
+    mHasElidedStore = false;
+    return true;
+  }
+
+  /**
+   * Record that the current instruction writes memory, which may hold the doublewords the loaded registers were read
+   * from. Instructions lifted by the base lifter clear the whole state instead
+   */
+  void ClearLoads() {
+    mRecorded = true;
+    mLoaded = 0;
+  }
+
+  /**
+   * Record that the current instruction leaves an unknown value in a register, and touches no other tracked register
+   */
+  void Clear(uint8_t reg) {
+    mRecorded = true;
+    if (reg < 31) {
+      Forget(reg);
+    }
+  }
+
+private:
+  void Forget(uint8_t reg) {
+    mKnown &= ~(1u << reg);
+    mLoaded &= ~(1u << reg);
+    mEstimates &= ~(1u << reg);
+    mWordEstimates &= ~(1u << reg);
+    mSignBits &= ~(1u << reg);
+    if (reg == mDivision.dividend) {
+      mHasDivision = false;
+    }
+  }
+};
+
+} // namespace aarch64
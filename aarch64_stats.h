@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "aarch64_decoder.h"
+
+namespace aarch64 {
+
+// Per-mnemonic lift counters
+enum LiftCounter : uint8_t {
+  // A lifter was called for the instruction
+  kAttempted,
+  // The lifter emitted IL
+  kLifted,
+  // The lifter rejected the operands
+  kRejected,
+  // The instruction was passed to the base lifter, be it unsupported or rejected
+  kFallback,
+  // Cycles spent in the lifter, only counted when lifter timing is enabled
+  kCycles,
+  kLiftCounterCount
+};
+
+// Decode cache counters
+enum CacheCounter : uint8_t {
+  kCacheHits,
+  kCacheMisses,
+  // Instructions decoded ahead of a miss
+  kPrefetched,
+  // Hits on an entry decoded ahead, counted once per entry, included in kCacheHits
+  kPrefetchHits,
+  // Misses served from a decode store loaded from the database rather than decoded
+  kStoreHits,
+  // Instructions handed to the base lifter on a clear prescan bit, never looked up in the decode cache
+  kPrescanSkips,
+  kCacheCounterCount
+};
+
+constexpr size_t kOpcodeCount = static_cast<size_t>(Opcode::Count);
+
+/**
+ * Statistics summed over all threads, including the threads that already exited
+ */
+struct StatisticsTotals {
+  uint64_t lift[kOpcodeCount][kLiftCounterCount];
+  uint64_t cache[kCacheCounterCount];
+};
+
+/**
+ * Read a free-running cycle counter, only meaningful as a difference between two reads on the same thread
+ */
+inline uint64_t ReadCycleCounter() {
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) ||             \
+    defined(__i386__)
+  return __rdtsc();
+#elif defined(_M_ARM64)
+  return _ReadStatusReg(ARM64_CNTVCT);
+#elif defined(__aarch64__)
+  uint64_t cycles;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(cycles));
+  return cycles;
+#else
+  return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/**
+ * Lift statistics, owned by a single thread
+ *
+ * Only the owning thread updates the counters. They are atomics written with plain relaxed stores, so that they can
+ * be aggregated from any thread without locking, or even contending on, the hot path
+ */
+class ThreadStatistics {
+private:
+  std::atomic<uint64_t> mLift[kOpcodeCount][kLiftCounterCount] {};
+  std::atomic<uint64_t> mCache[kCacheCounterCount] {};
+
+  struct Registry {
+    std::mutex mutex;
+    std::vector<const ThreadStatistics*> threads;
+    // Totals of the threads that already exited
+    StatisticsTotals retired {};
+  };
+
+  // Intentionally leaked, threads may exit and statistics may be dumped after static destructors ran
+  static Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  static void Add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+  }
+
+  void AddTo(StatisticsTotals& totals) const {
+    for (size_t opcode = 0; opcode < kOpcodeCount; opcode++) {
+      for (size_t counter = 0; counter < kLiftCounterCount; counter++) {
+        totals.lift[opcode][counter] +=
+            mLift[opcode][counter].load(std::memory_order_relaxed);
+      }
+    }
+
+    for (size_t counter = 0; counter < kCacheCounterCount; counter++) {
+      totals.cache[counter] += mCache[counter].load(std::memory_order_relaxed);
+    }
+  }
+
+public:
+  ThreadStatistics() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(this);
+  }
+
+  ~ThreadStatistics() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.erase(std::remove(registry.threads.begin(),
+                                       registry.threads.end(), this),
+                           registry.threads.end());
+    AddTo(registry.retired);
+  }
+
+  ThreadStatistics(const ThreadStatistics&) = delete;
+  ThreadStatistics& operator=(const ThreadStatistics&) = delete;
+
+  void Add(Opcode opcode, LiftCounter counter, uint64_t value = 1) {
+    Add(mLift[static_cast<size_t>(opcode)][counter], value);
+  }
+
+  void Add(CacheCounter counter) {
+    Add(mCache[counter], 1);
+  }
+
+  static StatisticsTotals GetTotals() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    StatisticsTotals totals = registry.retired;
+    for (const ThreadStatistics* thread : registry.threads) {
+      thread->AddTo(totals);
+    }
+
+    return totals;
+  }
+};
+
+} // namespace aarch64
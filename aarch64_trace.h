@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "aarch64_decoder.h"
+
+// Sampled timeline of lift calls, exported in the Chrome trace event format that chrome://tracing and Perfetto load.
+// Meant for the analyses that stall on one function, which the totals of the lift statistics do not explain
+
+namespace aarch64 {
+
+/**
+ * One sampled lift call
+ */
+struct TraceEvent {
+  uint64_t addr;
+  // Steady clock, in nanoseconds
+  uint64_t start;
+  uint32_t duration;
+  Opcode opcode;
+  // Lifted by the base architecture, be it unsupported or rejected
+  bool fallback;
+  // Index of the recording thread, in the order threads started tracing
+  uint32_t thread;
+};
+
+inline uint64_t ReadTraceClock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * Ring buffer of the lift events of a single thread, the oldest are overwritten once it is full
+ *
+ * Only the owning thread records. Slots are atomics written with relaxed stores and the head is published after the
+ * slot, so that any thread can take a snapshot without locking: the events overwritten while it was being copied are
+ * detected from the head and dropped
+ */
+class ThreadTrace {
+public:
+  static constexpr size_t kCapacity = 16384;
+
+private:
+  struct Slot {
+    std::atomic<uint64_t> addr;
+    std::atomic<uint64_t> start;
+    // Duration in the low 32 bits, then opcode and fallback flag
+    std::atomic<uint64_t> packed;
+  };
+
+  struct Registry {
+    std::mutex mutex;
+    std::vector<const ThreadTrace*> threads;
+    uint32_t nextThread = 0;
+    // Events of the threads that already exited, the most recent kRetired
+    std::vector<TraceEvent> retired;
+  };
+
+  static constexpr size_t kRetired = kCapacity * 16;
+
+  Slot mSlots[kCapacity];
+  std::atomic<uint64_t> mHead {0};
+  uint32_t mThread;
+  uint32_t mCountdown = 1;
+
+  // Intentionally leaked, like the statistics registry
+  static Registry& GetRegistry() {
+    static Registry* registry = new Registry();
+    return *registry;
+  }
+
+  void AddTo(std::vector<TraceEvent>& events) const {
+    uint64_t head = mHead.load(std::memory_order_acquire);
+    uint64_t first = head > kCapacity ? head - kCapacity : 0;
+    size_t begin = events.size();
+    for (uint64_t i = first; i < head; i++) {
+      const Slot& slot = mSlots[i % kCapacity];
+      uint64_t packed = slot.packed.load(std::memory_order_relaxed);
+      events.push_back({slot.addr.load(std::memory_order_relaxed),
+                        slot.start.load(std::memory_order_relaxed),
+                        static_cast<uint32_t>(packed),
+                        static_cast<Opcode>(packed >> 32 & 0xFF),
+                        (packed >> 40 & 1) != 0, mThread});
+    }
+
+    // Slots the owner moved past during the copy may hold newer events
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t now = mHead.load(std::memory_order_relaxed);
+    if (now - first > kCapacity) {
+      size_t torn = static_cast<size_t>(
+          std::min<uint64_t>(now - first - kCapacity, head - first));
+      events.erase(events.begin() + begin, events.begin() + begin + torn);
+    }
+  }
+
+public:
+  ThreadTrace() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    mThread = registry.nextThread++;
+    registry.threads.push_back(this);
+  }
+
+  ~ThreadTrace() {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.erase(std::remove(registry.threads.begin(),
+                                       registry.threads.end(), this),
+                           registry.threads.end());
+    AddTo(registry.retired);
+    if (registry.retired.size() > kRetired) {
+      registry.retired.erase(registry.retired.begin(),
+                             registry.retired.end() - kRetired);
+    }
+  }
+
+  ThreadTrace(const ThreadTrace&) = delete;
+  ThreadTrace& operator=(const ThreadTrace&) = delete;
+
+  /**
+   * Count a lift call
+   *
+   * @return true for one call in interval, which is then recorded
+   */
+  bool Sample(uint32_t interval) {
+    if (--mCountdown != 0) {
+      return false;
+    }
+
+    mCountdown = interval;
+    return true;
+  }
+
+  void Record(uint64_t addr, uint64_t start, uint64_t end, Opcode opcode,
+              bool fallback) {
+    uint64_t head = mHead.load(std::memory_order_relaxed);
+    Slot& slot = mSlots[head % kCapacity];
+    uint64_t duration = std::min<uint64_t>(end - start, UINT32_MAX);
+    slot.addr.store(addr, std::memory_order_relaxed);
+    slot.start.store(start, std::memory_order_relaxed);
+    slot.packed.store(duration | static_cast<uint64_t>(opcode) << 32 |
+                          static_cast<uint64_t>(fallback) << 40,
+                      std::memory_order_relaxed);
+    mHead.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * Events of all threads, including the threads that already exited, sorted by start
+   */
+  static std::vector<TraceEvent> GetEvents() {
+    Registry& registry = GetRegistry();
+    std::vector<TraceEvent> events;
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      events = registry.retired;
+      for (const ThreadTrace* thread : registry.threads) {
+        thread->AddTo(events);
+      }
+    }
+
+    std::sort(events.begin(), events.end(),
+              [](const TraceEvent& a, const TraceEvent& b) {
+                return a.start < b.start;
+              });
+    return events;
+  }
+};
+
+/**
+ * Format events as a Chrome trace event JSON object, one complete event per lift call and timestamps in microseconds
+ * from the first event
+ */
+inline std::string FormatChromeTrace(const std::vector<TraceEvent>& events) {
+  std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+  uint64_t origin = events.empty() ? 0 : events.front().start;
+  char line[256];
+  for (size_t i = 0; i < events.size(); i++) {
+    const TraceEvent& event = events[i];
+    snprintf(line, sizeof(line),
+             "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,"
+             "\"dur\":%.3f,\"pid\":1,\"tid\":%" PRIu32
+             ",\"args\":{\"addr\":\"0x%" PRIx64 "\"}}",
+             i != 0 ? "," : "", GetOpcodeName(event.opcode),
+             event.fallback ? "fallback" : "lifted",
+             (event.start - origin) / 1e3, event.duration / 1e3, event.thread,
+             event.addr);
+    json += line;
+  }
+
+  json += "\n]}\n";
+  return json;
+}
+
+} // namespace aarch64
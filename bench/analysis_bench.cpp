@@ -0,0 +1,332 @@
+// Analysis benchmark: opens AArch64 binaries headless, runs the full analysis and reports its wall time, the size of
+// the resulting LLIL and MLIL and the time spent generating the HLIL of each function
+//
+// The extension replaces the aarch64 architecture for the whole process, so each mode runs in its own process:
+// --base analyzes with the stock arm64 lifter, --extension with the lifters compiled into the benchmark. Without
+// either, the benchmark runs itself once per mode on the same binaries and compares the two
+
+#include <binaryninjaapi.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "aarch64_stats.h"
+
+using namespace BinaryNinja;
+
+extern "C" bool CorePluginInit();
+
+/**
+ * Analysis of one binary in one mode
+ */
+struct Result {
+  std::string path;
+  double seconds = 0;
+  uint64_t functions = 0;
+  uint64_t llilInstructions = 0;
+  uint64_t llilBlocks = 0;
+  uint64_t mlilInstructions = 0;
+  uint64_t mlilBlocks = 0;
+  // HLIL generation summed over all functions, and of the slowest function
+  double hlilSeconds = 0;
+  double hlilMaxSeconds = 0;
+};
+
+static double SecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+/**
+ * Open and analyze a binary, and print its slowest functions to HLIL
+ *
+ * @param slowest number of functions to print
+ * @return false if the binary could not be opened or is not AArch64
+ */
+static bool Analyze(const std::string& path, size_t slowest, Result& result) {
+  result.path = path;
+
+  Ref<BinaryView> view = Load(path, false);
+  if (!view) {
+    fprintf(stderr, "%s: failed to open\n", path.c_str());
+    return false;
+  }
+
+  Ref<Architecture> arch = view->GetDefaultArchitecture();
+  if (!arch || arch->GetName() != "aarch64") {
+    fprintf(stderr, "%s: not an AArch64 binary\n", path.c_str());
+    view->GetFile()->Close();
+    return false;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  view->UpdateAnalysisAndWait();
+  result.seconds = SecondsSince(start);
+
+  // Functions timed to HLIL, by start address
+  std::vector<std::pair<double, uint64_t>> hlil;
+  for (const Ref<Function>& function : view->GetAnalysisFunctionList()) {
+    result.functions++;
+
+    Ref<LowLevelILFunction> llil = function->GetLowLevelIL();
+    if (llil) {
+      result.llilInstructions += llil->GetInstructionCount();
+      result.llilBlocks += llil->GetBasicBlocks().size();
+    }
+
+    Ref<MediumLevelILFunction> mlil = function->GetMediumLevelIL();
+    if (mlil) {
+      result.mlilInstructions += mlil->GetInstructionCount();
+      result.mlilBlocks += mlil->GetBasicBlocks().size();
+    }
+
+    // Generated on request unless the analysis already did
+    auto hlilStart = std::chrono::steady_clock::now();
+    function->GetHighLevelIL();
+    double seconds = SecondsSince(hlilStart);
+    result.hlilSeconds += seconds;
+    result.hlilMaxSeconds = std::max(result.hlilMaxSeconds, seconds);
+    hlil.emplace_back(seconds, function->GetStart());
+  }
+
+  std::sort(hlil.begin(), hlil.end(),
+            [](const std::pair<double, uint64_t>& a,
+               const std::pair<double, uint64_t>& b) {
+              return a.first > b.first;
+            });
+  for (size_t i = 0; i < std::min(slowest, hlil.size()); i++) {
+    printf("  hlil %10.3f ms  0x%" PRIx64 "\n", hlil[i].first * 1e3,
+           hlil[i].second);
+  }
+
+  view->GetFile()->Close();
+  return true;
+}
+
+static void PrintHeader() {
+  printf("%-32s %-10s %10s %9s %12s %10s %12s %10s %10s %10s\n", "binary",
+         "mode", "analysis s", "functions", "llil instrs", "llil blocks",
+         "mlil instrs", "mlil blocks", "hlil s", "hlil max s");
+}
+
+static void PrintResult(const Result& result, const char* mode) {
+  // Long paths are cut from the left, the file name is what tells binaries apart
+  std::string name = result.path.size() > 32
+                         ? result.path.substr(result.path.size() - 32)
+                         : result.path;
+  printf("%-32s %-10s %10.2f %9" PRIu64 " %12" PRIu64 " %10" PRIu64
+         " %12" PRIu64 " %10" PRIu64 " %10.2f %10.3f\n",
+         name.c_str(), mode, result.seconds, result.functions,
+         result.llilInstructions, result.llilBlocks, result.mlilInstructions,
+         result.mlilBlocks, result.hlilSeconds, result.hlilMaxSeconds);
+}
+
+static bool WriteResults(const std::string& path,
+                         const std::vector<Result>& results) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+
+  for (const Result& result : results) {
+    fprintf(file,
+            "%.6f %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRIu64
+            " %.6f %.6f %s\n",
+            result.seconds, result.functions, result.llilInstructions,
+            result.llilBlocks, result.mlilInstructions, result.mlilBlocks,
+            result.hlilSeconds, result.hlilMaxSeconds, result.path.c_str());
+  }
+
+  return fclose(file) == 0;
+}
+
+static std::vector<Result> ReadResults(const std::string& path) {
+  std::vector<Result> results;
+  FILE* file = fopen(path.c_str(), "r");
+  if (file == nullptr) {
+    return results;
+  }
+
+  char line[4096];
+  while (fgets(line, sizeof(line), file) != nullptr) {
+    Result result;
+    int consumed = 0;
+    if (sscanf(line,
+               "%lf %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNu64
+               " %lf %lf %n",
+               &result.seconds, &result.functions, &result.llilInstructions,
+               &result.llilBlocks, &result.mlilInstructions,
+               &result.mlilBlocks, &result.hlilSeconds,
+               &result.hlilMaxSeconds, &consumed) != 8) {
+      continue;
+    }
+
+    result.path = line + consumed;
+    result.path.erase(result.path.find_last_not_of("\r\n") + 1);
+    results.push_back(result);
+  }
+
+  fclose(file);
+  return results;
+}
+
+/**
+ * Analyze the binaries in a child process, in one mode
+ */
+static std::vector<Result> RunMode(const std::string& program,
+                                   const char* mode, size_t slowest,
+                                   const std::vector<std::string>& paths) {
+  std::string output =
+      "aarch64_analysis_bench." + std::string(mode + 2) + ".txt";
+  std::string command = "\"" + program + "\" " + mode + " --output \"" +
+                        output + "\" --slowest " + std::to_string(slowest);
+  for (const std::string& path : paths) {
+    command += " \"" + path + "\"";
+  }
+
+  printf("%s\n", mode + 2);
+  fflush(stdout);
+  if (std::system(command.c_str()) != 0) {
+    fprintf(stderr, "%s run failed\n", mode + 2);
+  }
+
+  std::vector<Result> results = ReadResults(output);
+  remove(output.c_str());
+  return results;
+}
+
+static void Compare(const std::vector<Result>& base,
+                    const std::vector<Result>& extension) {
+  printf("\n");
+  PrintHeader();
+  double baseTotal = 0;
+  double extensionTotal = 0;
+  for (const Result& result : base) {
+    for (const Result& other : extension) {
+      if (other.path != result.path) {
+        continue;
+      }
+
+      PrintResult(result, "base");
+      PrintResult(other, "extension");
+      printf("%-32s %-10s %9.1f%%\n", "", "change",
+             result.seconds != 0
+                 ? 100.0 * (other.seconds - result.seconds) / result.seconds
+                 : 0.0);
+      baseTotal += result.seconds;
+      extensionTotal += other.seconds;
+    }
+  }
+
+  printf("\ntotal analysis: %.2f s base, %.2f s extension, %.1f%% change\n",
+         baseTotal, extensionTotal,
+         baseTotal != 0 ? 100.0 * (extensionTotal - baseTotal) / baseTotal
+                        : 0.0);
+}
+
+static void Usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--base | --extension] [--output FILE] [--slowest N] "
+          "binary...\n"
+          "  --base         analyze with the stock arm64 lifter only\n"
+          "  --extension    analyze with the extension registered\n"
+          "                 without either, run both modes and compare them\n"
+          "  --output FILE  also write the results to FILE, one line per "
+          "binary\n"
+          "  --slowest N    print the N functions slowest to HLIL (default "
+          "10)\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  const char* mode = nullptr;
+  std::string output;
+  size_t slowest = 10;
+  std::vector<std::string> paths;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--base") == 0 ||
+        strcmp(argv[i], "--extension") == 0) {
+      mode = argv[i];
+    } else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+      output = argv[++i];
+    } else if (strcmp(argv[i], "--slowest") == 0 && i + 1 < argc) {
+      slowest = strtoul(argv[++i], nullptr, 0);
+    } else if (argv[i][0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+
+  if (paths.empty()) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  if (mode == nullptr) {
+    std::vector<Result> base = RunMode(argv[0], "--base", slowest, paths);
+    std::vector<Result> extension =
+        RunMode(argv[0], "--extension", slowest, paths);
+    Compare(base, extension);
+    return base.size() == paths.size() && extension.size() == paths.size()
+               ? 0
+               : 1;
+  }
+
+  bool base = strcmp(mode, "--base") == 0;
+
+  SetBundledPluginDirectory(GetBundledPluginDirectory());
+  // User plugins are skipped, an installed copy of the extension would be registered twice
+  InitPlugins(false);
+
+  if (!base && !CorePluginInit()) {
+    fprintf(stderr, "Failed to register the AArch64 extension\n");
+    BNShutdown();
+    return 1;
+  }
+
+  std::vector<Result> results;
+  for (const std::string& path : paths) {
+    printf("%s\n", path.c_str());
+    Result result;
+    if (Analyze(path, slowest, result)) {
+      results.push_back(result);
+    }
+  }
+
+  printf("\n");
+  PrintHeader();
+  for (const Result& result : results) {
+    PrintResult(result, mode + 2);
+  }
+
+  if (!base) {
+    aarch64::StatisticsTotals totals = aarch64::ThreadStatistics::GetTotals();
+    uint64_t lifted = 0;
+    uint64_t fallback = 0;
+    for (size_t opcode = 0; opcode < aarch64::kOpcodeCount; opcode++) {
+      lifted += totals.lift[opcode][aarch64::kLifted];
+      fallback += totals.lift[opcode][aarch64::kFallback];
+    }
+
+    printf("\nlifted by the extension: %" PRIu64 " of %" PRIu64
+           " instructions\n",
+           lifted, lifted + fallback);
+  }
+
+  if (!output.empty() && !WriteResults(output, results)) {
+    fprintf(stderr, "Failed to write %s\n", output.c_str());
+  }
+
+  BNShutdown();
+  return results.size() == paths.size() ? 0 : 1;
+}
@@ -0,0 +1,672 @@
+// Lifter microbenchmark: feeds a synthetic corpus of instruction words through GetInstructionLowLevelIL of the
+// aarch64 architecture and reports the cost per instruction, for each lifter and for a realistic mix
+//
+// Runs headless, the lifters are compiled into the benchmark and registered over the bundled arm64 architecture.
+// With --base the extension is not registered, which measures the stock lifter on the same corpus. With --scaling the
+// mixed group is lifted from 1 to 64 threads at once, which measures how the per-thread state scales
+
+#include <binaryninjaapi.h>
+
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "aarch64_stats.h"
+
+using namespace BinaryNinja;
+
+extern "C" bool CorePluginInit();
+
+// Every operator new in the process is counted, including the ones made by the core while building IL
+static std::atomic<uint64_t> allocations {0};
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void* ptr = malloc(size != 0 ? size : 1);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+// Sized deallocation is on by default since C++14
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+// Deterministic xorshift, so that every run lifts the same corpus
+static uint32_t Random() {
+  static uint32_t state = 0x2545F491;
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+  return state;
+}
+
+static uint32_t RandomRegister() {
+  return Random() % 31;
+}
+
+static uint32_t RandomCondition() {
+  return Random() % 14;
+}
+
+static uint32_t ConditionalSelect(uint32_t base, uint32_t sf, uint32_t rd,
+                                  uint32_t rn, uint32_t rm, uint32_t cond) {
+  return base | sf << 31 | rm << 16 | cond << 12 | rn << 5 | rd;
+}
+
+/**
+ * Corpus of instruction words lifted together, reported as one line
+ */
+struct Group {
+  std::string name;
+  std::vector<uint32_t> words;
+};
+
+static const size_t kGroupSize = 1024;
+
+template <typename Generator>
+static Group MakeGroup(const char* name, Generator generate) {
+  Group group;
+  group.name = name;
+  for (size_t i = 0; i < kGroupSize; i++) {
+    // Alternate between the 32-bit and the 64-bit form
+    group.words.push_back(generate(static_cast<uint32_t>(i & 1)));
+  }
+  return group;
+}
+
+// Common instructions no lifter handles, standing in for the bulk of real code
+static uint32_t UnsupportedInstruction() {
+  switch (Random() % 14) {
+  case 0: // and xd, xn, xm
+    return 0x8A000000 | RandomRegister() << 16 | RandomRegister() << 5 |
+           RandomRegister();
+  case 1: // sub xd, xn, #imm
+    return 0xD1000000 | (Random() % 4096) << 10 | RandomRegister() << 5 |
+           RandomRegister();
+  case 2: // ldrb wt, [xn, #imm]
+    return 0x39400000 | (Random() % 4096) << 10 | RandomRegister() << 5 |
+           RandomRegister();
+  case 3: // str xt, [xn, #imm]
+    return 0xF9000000 | (Random() % 4096) << 10 | RandomRegister() << 5 |
+           RandomRegister();
+  case 4: // ldp x29, x30, [sp], #16
+    return 0xA8C17BFD;
+  case 5: // stp x29, x30, [sp, #-16]!
+    return 0xA9BF7BFD;
+  case 6: // mov xd, xm
+    return 0xAA0003E0 | RandomRegister() << 16 | RandomRegister();
+  case 7: // eor xd, xn, xm
+    return 0xCA000000 | RandomRegister() << 16 | RandomRegister() << 5 |
+           RandomRegister();
+  case 8: // b label
+    return 0x14000000 | (Random() % 0x1000);
+  case 9: // bl label
+    return 0x94000000 | (Random() % 0x1000);
+  case 10: // b.cond label
+    return 0x54000000 | (Random() % 0x1000) << 5 | RandomCondition();
+  case 11: // ret
+    return 0xD65F03C0;
+  case 12: // adr xd, label
+    return 0x10000000 | (Random() % 0x1000) << 5 | RandomRegister();
+  default: // nop
+    return 0xD503201F;
+  }
+}
+
+static std::vector<Group> MakeCorpus() {
+  std::vector<Group> corpus;
+
+  corpus.push_back(MakeGroup("csel", [](uint32_t sf) {
+    return ConditionalSelect(0x1A800000, sf, RandomRegister(),
+                             RandomRegister(), RandomRegister(),
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("csinc", [](uint32_t sf) {
+    return ConditionalSelect(0x1A800400, sf, RandomRegister(), 1, 2,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("cinc", [](uint32_t sf) {
+    uint32_t rn = RandomRegister();
+    return ConditionalSelect(0x1A800400, sf, RandomRegister(), rn, rn,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("cset", [](uint32_t sf) {
+    return ConditionalSelect(0x1A800400, sf, RandomRegister(), 31, 31,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("csinv", [](uint32_t sf) {
+    return ConditionalSelect(0x5A800000, sf, RandomRegister(), 1, 2,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("csetm", [](uint32_t sf) {
+    return ConditionalSelect(0x5A800000, sf, RandomRegister(), 31, 31,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("csneg", [](uint32_t sf) {
+    return ConditionalSelect(0x5A800400, sf, RandomRegister(), 1, 2,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("cneg", [](uint32_t sf) {
+    uint32_t rn = RandomRegister();
+    return ConditionalSelect(0x5A800400, sf, RandomRegister(), rn, rn,
+                             RandomCondition());
+  }));
+  corpus.push_back(MakeGroup("umull", [](uint32_t) {
+    return 0x9BA07C00 | RandomRegister() << 16 | RandomRegister() << 5 |
+           RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("madd", [](uint32_t sf) {
+    return 0x1B000000 | sf << 31 | RandomRegister() << 16 |
+           RandomRegister() << 10 | RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("umulh", [](uint32_t) {
+    return 0x9BC07C00 | RandomRegister() << 16 | RandomRegister() << 5 |
+           RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("bfi", [](uint32_t sf) {
+    uint32_t bits = sf ? 64 : 32;
+    uint32_t lsb = 1 + Random() % (bits - 1);
+    uint32_t width = 1 + Random() % (bits - lsb);
+    return 0x33000000 | sf << 31 | sf << 22 | ((bits - lsb) % bits) << 16 |
+           (width - 1) << 10 | RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("ubfx", [](uint32_t sf) {
+    uint32_t bits = sf ? 64 : 32;
+    uint32_t lsb = Random() % (bits - 1);
+    uint32_t width = 1 + Random() % (bits - 1 - lsb);
+    return 0x53000000 | sf << 31 | sf << 22 | lsb << 16 |
+           (lsb + width - 1) << 10 | RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("sbfx", [](uint32_t sf) {
+    uint32_t bits = sf ? 64 : 32;
+    uint32_t lsb = Random() % (bits - 1);
+    uint32_t width = 1 + Random() % (bits - 1 - lsb);
+    return 0x13000000 | sf << 31 | sf << 22 | lsb << 16 |
+           (lsb + width - 1) << 10 | RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("extr", [](uint32_t sf) {
+    // Distinct source registers, the same register twice is ROR
+    uint32_t rn = RandomRegister();
+    uint32_t rm = (rn + 1 + Random() % 30) % 31;
+    return 0x13800000 | sf << 31 | sf << 22 | rm << 16 |
+           (Random() % (sf ? 64 : 32)) << 10 | rn << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("ror-imm", [](uint32_t sf) {
+    uint32_t rs = RandomRegister();
+    return 0x13800000 | sf << 31 | sf << 22 | rs << 16 |
+           (Random() % (sf ? 64 : 32)) << 10 | rs << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("ror-reg", [](uint32_t sf) {
+    return 0x1AC02C00 | sf << 31 | RandomRegister() << 16 |
+           RandomRegister() << 5 | RandomRegister();
+  }));
+  // Vector groups alternate between the 64-bit and the 128-bit register forms
+  corpus.push_back(MakeGroup("vadd", [](uint32_t q) {
+    return 0x0E208400 | q << 30 | (Random() % 3) << 22 |
+           RandomRegister() << 16 | RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("veor", [](uint32_t q) {
+    return 0x2E201C00 | q << 30 | RandomRegister() << 16 |
+           RandomRegister() << 5 | RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("movi", [](uint32_t q) {
+    uint32_t imm8 = Random() % 256;
+    return 0x0F00E400 | q << 30 | (imm8 >> 5) << 16 | (imm8 & 31) << 5 |
+           RandomRegister();
+  }));
+  corpus.push_back(MakeGroup("ld1", [](uint32_t q) {
+    return 0x0C407000 | q << 30 | RandomRegister() << 5 | RandomRegister();
+  }));
+  // AES rounds, SHA256 and SHA512 updates and PMULL, as in TLS and storage code
+  corpus.push_back(MakeGroup("crypto", [](uint32_t q) {
+    uint32_t operands =
+        RandomRegister() << 16 | RandomRegister() << 5 | RandomRegister();
+    switch (Random() % 4) {
+    case 0: // aese, aesd, aesmc, aesimc
+      return 0x4E284800 | (Random() % 4) << 12 | (operands & 0x3FF);
+    case 1: // sha256h, sha256h2, sha256su1
+      return 0x5E004000 | (Random() % 3) << 12 | operands;
+    case 2: // sha512h, sha512h2, sha512su1
+      return 0xCE608000 | (Random() % 3) << 10 | operands;
+    default: // pmull, pmull2 of 1D elements
+      return 0x0EE0E000 | q << 30 | operands;
+    }
+  }));
+  corpus.push_back(MakeGroup("crc32", [](uint32_t sf) {
+    // crc32b, crc32h and crc32w, or crc32x, and their crc32c forms
+    uint32_t sz = sf ? 3 : Random() % 3;
+    return 0x1AC04000 | sf << 31 | RandomRegister() << 16 |
+           (Random() % 2) << 12 | sz << 10 | RandomRegister() << 5 |
+           RandomRegister();
+  }));
+  // Pointer authentication of arm64e and -mbranch-protection code: signed return addresses, data pointers and the
+  // authenticated branches
+  corpus.push_back(MakeGroup("pac", [](uint32_t key) {
+    uint32_t operands = RandomRegister() << 5 | RandomRegister();
+    switch (Random() % 6) {
+    case 0: // paciasp, pacibsp, autiasp, autibsp
+      return 0xD503233F | (Random() % 2) << 7 | key << 6;
+    case 1: // pacia, pacib, pacda, pacdb, autia, autib, autda, autdb
+      return 0xDAC10000 | (Random() % 4) << 11 | key << 10 | operands;
+    case 2: // xpaci, xpacd
+      return 0xDAC143E0 | key << 10 | RandomRegister();
+    case 3: // retaa, retab
+      return 0xD65F0BFF | key << 10;
+    case 4: // braa, brab
+      return 0xD71F0800 | key << 10 | operands;
+    default: // blraaz, blrabz
+      return 0xD63F081F | key << 10 | RandomRegister() << 5;
+    }
+  }));
+  // Vector-length-agnostic loops of SVE code: loop control, contiguous loads and stores, arithmetic and compares of
+  // random element sizes
+  corpus.push_back(MakeGroup("sve", [](uint32_t sf) {
+    uint32_t size = Random() % 4 << 22;
+    uint32_t operands =
+        RandomRegister() << 16 | (Random() % 8) << 10 | RandomRegister() << 5;
+    switch (Random() % 7) {
+    case 0: // ptrue pd.t
+      return 0x2518E3E0 | size | Random() % 16;
+    case 1: // whilelo pd.t, wn or xn, wm or xm
+      return 0x25200C00 | size | sf << 12 | (operands & 0x1F03E0) |
+             Random() % 16;
+    case 2: // incb to incd xdn
+      return 0x0430E3E0 | size | RandomRegister();
+    case 3: // ld1b to ld1d {zt.t}, pg/z, [xn, xm, lsl #esize]
+      return 0xA4004000 | (Random() % 4) * 5 << 21 | operands |
+             RandomRegister();
+    case 4: // st1b to st1d {zt.t}, pg, [xn, xm, lsl #esize]
+      return 0xE4004000 | (Random() % 4) * 5 << 21 | operands |
+             RandomRegister();
+    case 5: // add zd.t, zn.t, zm.t
+      return 0x04200000 | size | (operands & 0x1F03E0) | RandomRegister();
+    default: // cmpeq pd.t, pg/z, zn.t, #imm
+      return 0x25008000 | size | operands | Random() % 16;
+    }
+  }));
+  // LDADD, LDCLR, LDEOR, LDSET and SWP of W and X registers, CAS, with random ordering
+  corpus.push_back(MakeGroup("lse", [](uint32_t sf) {
+    uint32_t operands =
+        RandomRegister() << 16 | RandomRegister() << 5 | RandomRegister();
+    if (Random() % 6 == 0) {
+      return 0x88A07C00 | sf << 30 | (Random() % 2) << 22 |
+             (Random() % 2) << 15 | operands;
+    }
+
+    uint32_t opc = Random() % 5;
+    return 0xB8200000 | sf << 30 | (Random() % 4) << 22 |
+           (opc == 4 ? 0x8000 : opc << 12) | operands;
+  }));
+  // Exclusive loops collapsed into an atomic: ldaxr wt, [xn]; op wd, wt, ...; stlxr ws, wd, [xn]; cbnz ws, loop
+  Group exclusive;
+  exclusive.name = "exclusive";
+  while (exclusive.words.size() < kGroupSize) {
+    uint32_t rt = 0;
+    uint32_t rd = 1 + Random() % 2;
+    uint32_t rs = 3;
+    uint32_t rn = 4 + Random() % 27;
+    exclusive.words.push_back(0x885FFC00 | rn << 5 | rt);
+    switch (Random() % 3) {
+    case 0: // add wd, wt, #1
+      exclusive.words.push_back(0x11000400 | rt << 5 | rd);
+      break;
+    case 1: // sub wd, wt, #1
+      exclusive.words.push_back(0x51000400 | rt << 5 | rd);
+      break;
+    default: // orr wd, wt, w5
+      exclusive.words.push_back(0x2A050000 | rt << 5 | rd);
+      break;
+    }
+    exclusive.words.push_back(0x8800FC00 | rs << 16 | rn << 5 | rd);
+    exclusive.words.push_back(0x35FFFFA0 | rs);
+  }
+  corpus.push_back(exclusive);
+
+  // Address and constant materialization and division by a constant, lifted in sequence so that the last instruction
+  // of each is fused
+  Group sequences;
+  sequences.name = "sequences";
+  while (sequences.words.size() < kGroupSize) {
+    uint32_t rd = RandomRegister();
+    switch (Random() % 6) {
+    case 0: // adrp xd, label; add xd, xd, #imm
+      sequences.words.push_back(0x90000000 | (Random() % 0x1000) << 5 | rd);
+      sequences.words.push_back(0x91000000 | (Random() % 4096) << 10 |
+                                rd << 5 | rd);
+      break;
+    case 1: // adrp xd, label; ldr xt, [xd, #imm]
+      sequences.words.push_back(0x90000000 | (Random() % 0x1000) << 5 | rd);
+      sequences.words.push_back(0xF9400000 | (Random() % 4096) << 10 |
+                                rd << 5 | RandomRegister());
+      break;
+    case 2: // movz xd, #imm; movk xd, #imm, lsl #16
+      sequences.words.push_back(0xD2800000 | (Random() % 0x10000) << 5 | rd);
+      sequences.words.push_back(0xF2A00000 | (Random() % 0x10000) << 5 | rd);
+      break;
+    case 3: {
+      // wd = wn / 5: mov wd, #0x66666667; smull xd, wn, wd; asr xd, xd, #33; sub wd, wd, wn, asr #31
+      uint32_t rn = (rd + 1 + Random() % 30) % 31;
+      sequences.words.push_back(0x528CCCE0 | rd);
+      sequences.words.push_back(0x72ACCCC0 | rd);
+      sequences.words.push_back(0x9B207C00 | rd << 16 | rn << 5 | rd);
+      sequences.words.push_back(0x9361FC00 | rd << 5 | rd);
+      sequences.words.push_back(0x4B807C00 | rn << 16 | rd << 5 | rd);
+      break;
+    }
+    case 4: {
+      // wd = wn / 3: mov wd, #0x55555556; smull xd, wn, wd; lsr xd, xd, #32; sub wd, wd, wn, asr #31
+      uint32_t rn = (rd + 1 + Random() % 30) % 31;
+      sequences.words.push_back(0x528AAAC0 | rd);
+      sequences.words.push_back(0x72AAAAA0 | rd);
+      sequences.words.push_back(0x9B207C00 | rd << 16 | rn << 5 | rd);
+      sequences.words.push_back(0xD360FC00 | rd << 5 | rd);
+      sequences.words.push_back(0x4B807C00 | rn << 16 | rd << 5 | rd);
+      break;
+    }
+    default: {
+      // wd = wn / 10: mov wd, #0xcccccccd; umull xd, wn, wd; lsr xd, xd, #35
+      uint32_t rn = (rd + 1 + Random() % 30) % 31;
+      sequences.words.push_back(0x52999BA0 | rd);
+      sequences.words.push_back(0x72B99980 | rd);
+      sequences.words.push_back(0x9BA07C00 | rd << 16 | rn << 5 | rd);
+      sequences.words.push_back(0xD363FC00 | rd << 5 | rd);
+      break;
+    }
+    }
+  }
+  corpus.push_back(sequences);
+
+  // Import stubs, lifted in sequence so that the branch is resolved to the GOT slot
+  Group stubs;
+  stubs.name = "stubs";
+  while (stubs.words.size() < kGroupSize) {
+    uint32_t page = (Random() % 0x1000) << 5;
+    uint32_t offset = (Random() % 512) * 8;
+    if (Random() % 2 == 0) {
+      // adrp x16, page; ldr x17, [x16, #offset]; add x16, x16, #offset; br x17
+      stubs.words.push_back(0x90000010 | page);
+      stubs.words.push_back(0xF9400211 | offset / 8 << 10);
+      stubs.words.push_back(0x91000210 | offset << 10);
+      stubs.words.push_back(0xD61F0220);
+    } else {
+      // arm64e: adrp x17, page; add x17, x17, #offset; ldr x16, [x17]; braa x16, x17
+      stubs.words.push_back(0x90000011 | page);
+      stubs.words.push_back(0x91000231 | offset << 10);
+      stubs.words.push_back(0xF9400230);
+      stubs.words.push_back(0xD71F0A11);
+    }
+  }
+  corpus.push_back(stubs);
+
+  // Comparisons and the instruction reading their flags right after them, fused into a direct comparison
+  Group comparisons;
+  comparisons.name = "comparisons";
+  while (comparisons.words.size() < kGroupSize) {
+    uint32_t sf = Random() % 2;
+    uint32_t rn = RandomRegister();
+    uint32_t rm = RandomRegister();
+    switch (Random() % 3) {
+    case 0: // cmp rn, #imm; csel rd, rn, rm, cond
+      comparisons.words.push_back(0x7100001F | sf << 31 |
+                                  (Random() % 4096) << 10 | rn << 5);
+      comparisons.words.push_back(ConditionalSelect(
+          0x1A800000, sf, RandomRegister(), rn, rm, RandomCondition()));
+      break;
+    case 1: // cmp rn, rm; b.cond .+8
+      comparisons.words.push_back(0x6B00001F | sf << 31 | rm << 16 | rn << 5);
+      comparisons.words.push_back(0x54000040 | RandomCondition());
+      break;
+    default: // cmp rn, rm; ccmp rn, #imm, #nzcv, cond; b.cond .+8
+      comparisons.words.push_back(0x6B00001F | sf << 31 | rm << 16 | rn << 5);
+      comparisons.words.push_back(0x7A400800 | sf << 31 |
+                                  (Random() % 32) << 16 |
+                                  RandomCondition() << 12 | rn << 5 |
+                                  Random() % 16);
+      comparisons.words.push_back(0x54000040 | RandomCondition());
+      break;
+    }
+  }
+  corpus.push_back(comparisons);
+
+  corpus.push_back(MakeGroup(
+      "unsupported", [](uint32_t) { return UnsupportedInstruction(); }));
+
+  // About one instruction in twenty handled by a lifter, as in typical compiled code
+  Group mixed;
+  mixed.name = "mixed";
+  for (size_t i = 0; i < kGroupSize; i++) {
+    if (Random() % 20 == 0) {
+      const Group& lifted = corpus[Random() % (corpus.size() - 1)];
+      mixed.words.push_back(lifted.words[Random() % lifted.words.size()]);
+    } else {
+      mixed.words.push_back(UnsupportedInstruction());
+    }
+  }
+  corpus.push_back(mixed);
+
+  return corpus;
+}
+
+static std::vector<uint8_t> Encode(const Group& group) {
+  std::vector<uint8_t> bytes(group.words.size() * 4);
+  for (size_t i = 0; i < group.words.size(); i++) {
+    for (size_t byte = 0; byte < 4; byte++) {
+      bytes[i * 4 + byte] =
+          static_cast<uint8_t>(group.words[i] >> (8 * byte));
+    }
+  }
+
+  return bytes;
+}
+
+/**
+ * Lift every word of a group, rounds times over fresh addresses so that the decode cache does not serve repeated
+ * words unless reuse is requested. The IL functions have no view, so each instruction is handed the rest of the group
+ * in its place, for the decode cache prefetch and the lifters that match the instructions ahead
+ */
+static void RunGroup(Architecture* arch, const Group& group, size_t rounds,
+                     bool reuseAddresses) {
+  std::vector<uint8_t> bytes = Encode(group);
+
+  aarch64::StatisticsTotals before = aarch64::ThreadStatistics::GetTotals();
+  std::chrono::steady_clock::duration elapsed {};
+  uint64_t allocated = 0;
+  uint64_t addr = 0x100000000;
+
+  for (size_t round = 0; round < rounds; round++) {
+    // A fresh function per round, so that the IL does not grow across the run
+    Ref<LowLevelILFunction> il = new LowLevelILFunction(arch, nullptr);
+    if (!reuseAddresses) {
+      addr += bytes.size();
+    }
+
+    uint64_t allocationsBefore = allocations.load(std::memory_order_relaxed);
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t offset = 0; offset < bytes.size(); offset += 4) {
+      size_t len = bytes.size() - offset;
+      il->SetCurrentAddress(arch, addr + offset);
+      arch->GetInstructionLowLevelIL(bytes.data() + offset, addr + offset, len,
+                                     *il);
+    }
+
+    elapsed += std::chrono::steady_clock::now() - start;
+    allocated +=
+        allocations.load(std::memory_order_relaxed) - allocationsBefore;
+  }
+
+  aarch64::StatisticsTotals after = aarch64::ThreadStatistics::GetTotals();
+  uint64_t lifted = 0;
+  for (size_t opcode = 0; opcode < aarch64::kOpcodeCount; opcode++) {
+    lifted += after.lift[opcode][aarch64::kLifted] -
+              before.lift[opcode][aarch64::kLifted];
+  }
+
+  double instructions = static_cast<double>(group.words.size() * rounds);
+  double ns =
+      std::chrono::duration<double, std::nano>(elapsed).count() / instructions;
+  printf("%-12s %12.0f %10.1f %14.2f %9.1f%%\n", group.name.c_str(),
+         instructions, ns, allocated / instructions,
+         100.0 * lifted / instructions);
+}
+
+/**
+ * Lift a group from 1 to 64 threads at once, each thread over its own fresh addresses and its own IL functions as
+ * separate analysis workers would, and report the aggregate throughput
+ */
+static void RunScaling(Architecture* arch, const Group& group,
+                       size_t rounds) {
+  std::vector<uint8_t> bytes = Encode(group);
+
+  printf("%-8s %14s %12s %9s\n", "threads", "instructions", "Minstr/s",
+         "speedup");
+  double single = 0;
+  for (size_t threads = 1; threads <= 64; threads *= 2) {
+    // Workers spin until all of them started, so that thread creation is not measured
+    std::atomic<size_t> ready {0};
+    std::atomic<bool> go {false};
+    std::vector<std::thread> workers;
+    for (size_t thread = 0; thread < threads; thread++) {
+      workers.emplace_back([&, thread]() {
+        uint64_t addr = 0x100000000 + (thread << 32);
+        ready.fetch_add(1);
+        while (!go.load(std::memory_order_acquire)) {
+          std::this_thread::yield();
+        }
+
+        for (size_t round = 0; round < rounds; round++) {
+          Ref<LowLevelILFunction> il = new LowLevelILFunction(arch, nullptr);
+          addr += bytes.size();
+          for (size_t offset = 0; offset < bytes.size(); offset += 4) {
+            size_t len = bytes.size() - offset;
+            il->SetCurrentAddress(arch, addr + offset);
+            arch->GetInstructionLowLevelIL(bytes.data() + offset,
+                                           addr + offset, len, *il);
+          }
+        }
+      });
+    }
+
+    while (ready.load() != threads) {
+      std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    double instructions =
+        static_cast<double>(group.words.size() * rounds * threads);
+    double throughput = instructions / seconds / 1e6;
+    if (threads == 1) {
+      single = throughput;
+    }
+
+    printf("%-8zu %14.0f %12.2f %8.2fx\n", threads, instructions, throughput,
+           throughput / single);
+  }
+}
+
+static void Usage(const char* program) {
+  fprintf(stderr,
+          "usage: %s [--base] [--rounds N] [--reuse-addresses] [--scaling] "
+          "[group...]\n"
+          "  --base             measure the stock arm64 lifter, without the "
+          "extension\n"
+          "  --rounds N         lift each group N times (default 200)\n"
+          "  --reuse-addresses  lift every round at the same addresses, so "
+          "that the decode cache hits\n"
+          "  --scaling          lift the mixed group, or the first group "
+          "given, from 1 to 64\n"
+          "                     threads at once\n",
+          program);
+}
+
+int main(int argc, char** argv) {
+  bool base = false;
+  bool reuseAddresses = false;
+  bool scaling = false;
+  size_t rounds = 200;
+  std::vector<std::string> selected;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--base") == 0) {
+      base = true;
+    } else if (strcmp(argv[i], "--reuse-addresses") == 0) {
+      reuseAddresses = true;
+    } else if (strcmp(argv[i], "--scaling") == 0) {
+      scaling = true;
+    } else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc) {
+      rounds = strtoul(argv[++i], nullptr, 0);
+    } else if (argv[i][0] == '-') {
+      Usage(argv[0]);
+      return 1;
+    } else {
+      selected.push_back(argv[i]);
+    }
+  }
+
+  SetBundledPluginDirectory(GetBundledPluginDirectory());
+  // User plugins are skipped, an installed copy of the extension would be registered twice
+  InitPlugins(false);
+
+  if (!base && !CorePluginInit()) {
+    fprintf(stderr, "Failed to register the AArch64 extension\n");
+    BNShutdown();
+    return 1;
+  }
+
+  Architecture* arch = Architecture::GetByName("aarch64");
+  if (arch == nullptr) {
+    fprintf(stderr, "AArch64 architecture is not available\n");
+    BNShutdown();
+    return 1;
+  }
+
+  if (scaling) {
+    std::string name = selected.empty() ? "mixed" : selected[0];
+    for (const Group& group : MakeCorpus()) {
+      if (group.name == name) {
+        RunScaling(arch, group, rounds);
+      }
+    }
+
+    BNShutdown();
+    return 0;
+  }
+
+  printf("%-12s %12s %10s %14s %10s\n", "group", "instructions", "ns/instr",
+         "allocs/instr", "lifted");
+  for (const Group& group : MakeCorpus()) {
+    bool run = selected.empty();
+    for (const std::string& name : selected) {
+      run = run || name == group.name;
+    }
+
+    if (run) {
+      RunGroup(arch, group, rounds, reuseAddresses);
+    }
+  }
+
+  BNShutdown();
+  return 0;
+}
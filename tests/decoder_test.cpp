@@ -0,0 +1,345 @@
+// Decoder tests: hand-encoded instruction words checked against their decoded form, divisors recovered from the magic
+// numbers GCC and Clang emit, and decode store round trips
+//
+// Only the header-only parts of the plugin are tested, so this needs neither the Binary Ninja core nor Capstone. Exits
+// with a non-zero status if any check fails
+
+#include <cinttypes>
+#include <cstdio>
+#include <initializer_list>
+#include <memory>
+#include <vector>
+
+#include "aarch64_decode_store.h"
+#include "aarch64_decoder.h"
+#include "aarch64_sequence.h"
+
+using aarch64::Condition;
+using aarch64::Opcode;
+
+static int failures = 0;
+
+#define CHECK(condition)                                                       \
+  do {                                                                         \
+    if (!(condition)) {                                                        \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                   #condition);                                                \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+/**
+ * Instruction word and the fields it decodes to, any field not listed must be 0
+ */
+struct DecodeCase {
+  uint32_t word;
+  Opcode opcode;
+  uint8_t size;
+  uint8_t rd;
+  uint8_t rn;
+  uint8_t rm;
+  uint64_t imm;
+};
+
+// Each word is preceded by its disassembly
+static const DecodeCase kDecodeCases[] = {
+    // csel x0, x1, x2, eq
+    {0x9A820020, Opcode::CSEL, 8, 0, 1, 2, 0},
+    // cset w0, eq
+    {0x1A9F17E0, Opcode::CSET, 4, 0, 31, 31, 0},
+    // madd x0, x1, x2, x3
+    {0x9B020C20, Opcode::MADD, 8, 0, 1, 2, 0},
+    // mul w0, w1, w2
+    {0x1B027C20, Opcode::MUL, 4, 0, 1, 2, 0},
+    // smull x0, w1, w2
+    {0x9B227C20, Opcode::SMULL, 8, 0, 1, 2, 0},
+    // umulh x0, x1, x2
+    {0x9BC27C20, Opcode::UMULH, 8, 0, 1, 2, 0},
+    // lsr x0, x1, #4
+    {0xD344FC20, Opcode::LSR, 8, 0, 1, 0, 4},
+    // lsl w0, w1, #3
+    {0x531D7020, Opcode::LSL, 4, 0, 1, 0, 3},
+    // ubfx x0, x1, #8, #4
+    {0xD3482C20, Opcode::UBFX, 8, 0, 1, 0, 0},
+    // sxtw x0, w1
+    {0x93407C20, Opcode::SXTW, 8, 0, 1, 0, 0},
+    // asr w0, w1, #31
+    {0x131F7C20, Opcode::ASR, 4, 0, 1, 0, 31},
+    // adrp x0, .+0x1000
+    {0xB0000000, Opcode::ADRP, 8, 0, 0, 0, 0x1000},
+    // add x0, sp, #16
+    {0x910043E0, Opcode::ADD, 8, 0, 31, 0, 16},
+    // add x0, x1, x2, lsl #3
+    {0x8B020C20, Opcode::ADD, 8, 0, 1, 2, 0},
+    // sub w0, w1, w2, asr #31
+    {0x4B827C20, Opcode::SUB, 4, 0, 1, 2, 0},
+    // cmp x1, #5
+    {0xF100143F, Opcode::CMP, 8, 31, 1, 0, 5},
+    // subs x0, x1, x2
+    {0xEB020020, Opcode::SUBS, 8, 0, 1, 2, 0},
+    // ldr x0, [x1, #8]
+    {0xF9400420, Opcode::LDR, 8, 0, 1, 0, 8},
+    // ldr w0, [x1, #8]
+    {0xB9400820, Opcode::LDR, 4, 0, 1, 0, 8},
+    // mov x0, #0x12340000
+    {0xD2A24680, Opcode::MOVZ, 8, 0, 0, 0, 0x12340000},
+    // movk w8, #0x5555, lsl #16
+    {0x72AAAAA8, Opcode::MOVK, 4, 8, 0, 0, 0x55550000},
+    // ldadd w0, w1, [x2]
+    {0xB8200041, Opcode::LDADD, 4, 1, 2, 0, 0},
+    // swp x0, x1, [x2]
+    {0xF8208041, Opcode::SWP, 8, 1, 2, 0, 0},
+    // ldxr x0, [x1]
+    {0xC85F7C20, Opcode::LDXR, 8, 0, 1, 31, 0},
+    // stxr w2, x0, [x1]
+    {0xC8027C20, Opcode::STXR, 8, 0, 1, 2, 0},
+    // br x16
+    {0xD61F0200, Opcode::BR, 8, 0, 16, 0, 0},
+};
+
+// Common instructions no lifter handles, which must not decode
+static const uint32_t kUndecodedWords[] = {
+    0xD503201F, // nop
+    0x8A020020, // and x0, x1, x2
+    0xCA020020, // eor x0, x1, x2
+    0xAA0203E0, // mov x0, x2
+    0x14000000, // b .
+    0x94000000, // bl .
+    0xD65F03C0, // ret
+    0xF9000020, // str x0, [x1]
+    0xA9BF7BFD, // stp x29, x30, [sp, #-16]!
+    0xD1000420, // sub x0, x1, #1
+};
+
+static void TestDecode() {
+  for (const DecodeCase& test : kDecodeCases) {
+    aarch64::Instruction instr;
+    if (!aarch64::Decode(test.word, instr)) {
+      std::fprintf(stderr, "%08" PRIx32 " does not decode\n", test.word);
+      failures++;
+      continue;
+    }
+
+    if (instr.opcode != test.opcode || instr.size != test.size ||
+        instr.rd != test.rd || instr.rn != test.rn || instr.rm != test.rm ||
+        instr.imm != test.imm) {
+      std::fprintf(stderr,
+                   "%08" PRIx32 " decodes to %s size %u rd %u rn %u rm %u imm "
+                   "%#" PRIx64 ", expected %s size %u rd %u rn %u rm %u imm "
+                   "%#" PRIx64 "\n",
+                   test.word, aarch64::GetOpcodeName(instr.opcode), instr.size,
+                   instr.rd, instr.rn, instr.rm, instr.imm,
+                   aarch64::GetOpcodeName(test.opcode), test.size, test.rd,
+                   test.rn, test.rm, test.imm);
+      failures++;
+    }
+  }
+
+  for (uint32_t word : kUndecodedWords) {
+    aarch64::Instruction instr;
+    if (aarch64::Decode(word, instr)) {
+      std::fprintf(stderr, "%08" PRIx32 " decodes to %s\n", word,
+                   aarch64::GetOpcodeName(instr.opcode));
+      failures++;
+    }
+  }
+
+  // The fields specific to some classes
+  aarch64::Instruction instr;
+  CHECK(aarch64::Decode(0x1A9F17E0, instr) && instr.cond == Condition::EQ);
+  CHECK(aarch64::Decode(0x9B020C20, instr) && instr.ra == 3);
+  CHECK(aarch64::Decode(0xD3482C20, instr) && instr.lsb == 8 &&
+        instr.width == 4);
+  CHECK(aarch64::Decode(0x8B020C20, instr) &&
+        instr.immr == aarch64::kShiftLsl && instr.imms == 3);
+  CHECK(aarch64::Decode(0x4B827C20, instr) &&
+        instr.immr == aarch64::kShiftAsr && instr.imms == 31);
+  // ccmp x1, x2, #0, ne
+  CHECK(aarch64::Decode(0xFA421020, instr) && instr.opcode == Opcode::CCMP &&
+        instr.cond == Condition::NE && instr.rn == 1 && instr.rm == 2);
+  // b.eq .+8
+  CHECK(aarch64::Decode(0x54000040, instr) && instr.opcode == Opcode::BCOND &&
+        instr.cond == Condition::EQ && instr.imm == 8);
+  // add v0.4s, v1.4s, v2.4s
+  CHECK(aarch64::Decode(0x4EA28420, instr) && instr.opcode == Opcode::VADD &&
+        instr.size == 16 && instr.esize == 4);
+
+  // The shift of ADD and SUB (shifted register) must be below the register size, and ROR is reserved
+  CHECK(!aarch64::Decode(0x0B028020, instr)); // add w0, w1, w2, lsl #32
+  CHECK(!aarch64::Decode(0x8BC20020, instr)); // add x0, x1, x2, ror #0
+
+  // Decoding against a subset of the classes leaves the others out
+  CHECK(!aarch64::Decode(0x9A820020, instr, aarch64::kEncodingClasses + 1,
+                         aarch64::kEncodingClassCount - 1));
+}
+
+static void TestExclusiveOperation() {
+  aarch64::ExclusiveOperation op;
+  // add w1, w0, #1
+  CHECK(aarch64::DecodeExclusiveOperation(0x11000401, op) &&
+        op.atomic == Opcode::LDADD && op.size == 4 && op.rd == 1 &&
+        op.rn == 0 && op.hasImmediate && op.imm == 1);
+  // sub x1, x0, #1
+  CHECK(aarch64::DecodeExclusiveOperation(0xD1000401, op) &&
+        op.atomic == Opcode::LDADD && op.size == 8 && op.imm == ~0ull);
+  // sub w1, w0, w2
+  CHECK(aarch64::DecodeExclusiveOperation(0x4B020001, op) &&
+        op.atomic == Opcode::LDADD && op.negate && op.rm == 2);
+  // eor x1, x0, x2
+  CHECK(aarch64::DecodeExclusiveOperation(0xCA020001, op) &&
+        op.atomic == Opcode::LDEOR);
+  // mov w1, w2
+  CHECK(aarch64::DecodeExclusiveOperation(0x2A0203E1, op) &&
+        op.atomic == Opcode::SWP);
+  // adds w1, w0, #1 writes the flags, which the atomic would not
+  CHECK(!aarch64::DecodeExclusiveOperation(0x31000401, op));
+  // add w1, w0, w2, lsl #1
+  CHECK(!aarch64::DecodeExclusiveOperation(0x0B020401, op));
+}
+
+/**
+ * Magic number, width and total right shift of a division by a constant, and the divisor, 0 if none may be recovered
+ */
+struct DivisorCase {
+  uint64_t magic;
+  unsigned int bits;
+  unsigned int shift;
+  uint64_t divisor;
+};
+
+static const DivisorCase kUnsignedDivisorCases[] = {
+    {0xAAAAAAAB, 32, 33, 3},
+    {0xCCCCCCCD, 32, 34, 5},
+    {0xCCCCCCCD, 32, 35, 10},
+    {0xCCCCCCCD, 32, 33, 0}, // rounded up from 5/2, off by too much
+    {0x51EB851F, 32, 37, 100},
+    {0xAAAAAAAAAAAAAAAB, 64, 65, 3},
+    {0xCCCCCCCCCCCCCCCD, 64, 67, 10},
+    {0, 32, 35, 0},
+    {0xCCCCCCCD, 32, 31, 0},
+};
+
+static const DivisorCase kSignedDivisorCases[] = {
+    {0x55555556, 32, 32, 3},
+    {0x2AAAAAAB, 32, 32, 6},
+    {0x66666667, 32, 33, 5},
+    {0x66666667, 32, 34, 10},
+    {0x5555555555555556, 64, 64, 3},
+    {0x6666666666666667, 64, 66, 10},
+    {0x4924924924924925, 64, 65, 7},
+    {0x40000000, 32, 33, 0}, // a power of two
+    {0x80000000, 32, 32, 0}, // negative
+};
+
+static void TestDivisors() {
+  for (const DivisorCase& test : kUnsignedDivisorCases) {
+    uint64_t divisor = 0;
+    bool found = aarch64::FindUnsignedDivisor(test.magic, test.bits,
+                                              test.shift, divisor);
+    if (found != (test.divisor != 0) || (found && divisor != test.divisor)) {
+      std::fprintf(stderr, "unsigned %#" PRIx64 " >> %u gives %" PRIu64 "\n",
+                   test.magic, test.shift, found ? divisor : 0);
+      failures++;
+    }
+  }
+
+  for (const DivisorCase& test : kSignedDivisorCases) {
+    uint64_t divisor = 0;
+    bool found = aarch64::FindSignedDivisor(test.magic, test.bits, test.shift,
+                                            divisor);
+    if (found != (test.divisor != 0) || (found && divisor != test.divisor)) {
+      std::fprintf(stderr, "signed %#" PRIx64 " >> %u gives %" PRIu64 "\n",
+                   test.magic, test.shift, found ? divisor : 0);
+      failures++;
+      continue;
+    }
+
+    // The quotient the compiled sequence computes, the shifted product plus the sign bit, of 32-bit dividends
+    // spread over the whole range
+    for (int64_t n = INT32_MIN; found && test.bits == 32 && n <= INT32_MAX;
+         n += 65521) {
+      int64_t mirrored = static_cast<int64_t>(INT32_MAX) - (n - INT32_MIN);
+      for (int64_t dividend : {n, mirrored}) {
+        int64_t product = dividend * static_cast<int64_t>(test.magic);
+        int64_t quotient = (product >> test.shift) + (dividend < 0);
+        if (quotient != dividend / static_cast<int64_t>(divisor)) {
+          std::fprintf(stderr, "%" PRId64 " / %" PRIu64 " gives %" PRId64 "\n",
+                       dividend, divisor, quotient);
+          failures++;
+          found = false;
+          break;
+        }
+      }
+    }
+  }
+}
+
+static void TestDecodeStore() {
+  const uint32_t words[] = {0x9A820020, 0xD344FC20, 0x910043E0, 0x4EA28420};
+
+  aarch64::DecodeStore store;
+  store.Reserve(4);
+  for (size_t i = 0; i < 4; i++) {
+    aarch64::Instruction instr;
+    CHECK(aarch64::Decode(words[i], instr));
+    CHECK(store.Add(0x100000 + i * 4, words[i], instr));
+  }
+  store.SetCoverage(0x0123456789ABCDEF);
+
+  std::vector<uint8_t> bytes = store.Serialize();
+  aarch64::DecodeStore loaded;
+  CHECK(loaded.Deserialize(bytes));
+  CHECK(loaded.GetCount() == 4);
+  CHECK(loaded.GetCoverage() == 0x0123456789ABCDEF);
+  for (size_t i = 0; i < 4; i++) {
+    aarch64::Instruction instr;
+    aarch64::Decode(words[i], instr);
+    const aarch64::Instruction* stored =
+        loaded.Find(0x100000 + i * 4, words[i]);
+    CHECK(stored != nullptr && stored->opcode == instr.opcode &&
+          stored->size == instr.size && stored->rd == instr.rd &&
+          stored->rn == instr.rn && stored->rm == instr.rm &&
+          stored->imm == instr.imm && stored->esize == instr.esize);
+  }
+
+  // A patched word or an address that was never stored is decoded again
+  CHECK(loaded.Find(0x100000, words[1]) == nullptr);
+  CHECK(loaded.Find(0x200000, words[0]) == nullptr);
+
+  // Another format version, a truncated header or a record count past the end are rejected
+  std::vector<uint8_t> corrupt = bytes;
+  corrupt[4]++;
+  CHECK(!aarch64::DecodeStore().Deserialize(corrupt));
+  CHECK(!aarch64::DecodeStore().Deserialize(
+      std::vector<uint8_t>(bytes.begin(), bytes.begin() + 20)));
+  CHECK(!aarch64::DecodeStore().Deserialize(
+      std::vector<uint8_t>(bytes.begin(), bytes.end() - 1)));
+
+  // The union of two stores holds the records of both
+  auto other = std::make_shared<aarch64::DecodeStore>();
+  other->Reserve(1);
+  aarch64::Instruction instr;
+  aarch64::Decode(words[0], instr);
+  CHECK(other->Add(0x300000, words[0], instr));
+  std::shared_ptr<const aarch64::DecodeStore> merged =
+      aarch64::DecodeStore::Merge(
+          {std::make_shared<aarch64::DecodeStore>(loaded), other});
+  CHECK(merged->GetCount() == 5);
+  CHECK(merged->Find(0x100004, words[1]) != nullptr);
+  CHECK(merged->Find(0x300000, words[0]) != nullptr);
+}
+
+int main() {
+  TestDecode();
+  TestExclusiveOperation();
+  TestDivisors();
+  TestDecodeStore();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d checks failed\n", failures);
+    return 1;
+  }
+
+  std::printf("All checks passed\n");
+  return 0;
+}